@@ -0,0 +1,102 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "dataflow/dataflow.hpp"
+
+// Benchmark of partitioned parallel execution against serial execution on a
+// graph of independent chains that are joined at the end
+
+constexpr std::size_t buffer_size = 1 << 16;
+
+class signal_source : public dataflow::outputs<std::vector<float>> {
+ public:
+  explicit signal_source(float seed) {
+    outputs::get<0>().resize(buffer_size);
+    std::iota(outputs::get<0>().begin(), outputs::get<0>().end(), seed);
+  }
+};
+
+class smooth : public dataflow::inputs<std::vector<float>>,
+               public dataflow::outputs<std::vector<float>> {
+ public:
+  void operator()() override {
+    const auto& in = inputs::get<0>();
+    auto& out = outputs::get<0>();
+    out.resize(in.size());
+    for (int pass = 0; pass < 2; ++pass) {
+      for (std::size_t i = 1; i + 1 < in.size(); ++i) {
+        out[i] = 0.25F * in[i - 1] + 0.5F * in[i] + 0.25F * in[i + 1];
+      }
+    }
+  }
+};
+
+class total : public dataflow::inputs<dataflow::many<std::vector<float>>>,
+              public dataflow::outputs<float> {
+ public:
+  void operator()() override {
+    float sum = 0;
+    for (auto&& chain : inputs::get<0>()) {
+      sum += std::accumulate(chain.begin(), chain.end(), 0.0F);
+    }
+    outputs::get<0>() = sum;
+  }
+};
+
+template <typename F>
+double time_runs(int runs, F&& f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; ++i) f();
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         runs;
+}
+
+int main(int, char**) {
+  constexpr std::size_t chains = 16;
+  constexpr std::size_t depth = 8;
+  constexpr int runs = 10;
+
+  std::vector<std::unique_ptr<dataflow::node>> nodes;
+  auto sink = std::make_unique<total>();
+  for (std::size_t c = 0; c < chains; ++c) {
+    auto source = std::make_unique<signal_source>(static_cast<float>(c));
+    const dataflow::node* previous = source.get();
+    nodes.push_back(std::move(source));
+    for (std::size_t d = 0; d < depth; ++d) {
+      auto step = std::make_unique<smooth>();
+      step->input(0) = previous->output(0);
+      previous = step.get();
+      nodes.push_back(std::move(step));
+    }
+    sink->input(0) = previous->output(0);
+  }
+  nodes.push_back(std::move(sink));
+
+  std::vector<dataflow::node*> ptrs;
+  for (auto& n : nodes) ptrs.push_back(n.get());
+  dataflow::graph g{ptrs};
+  dataflow::plan p{g};
+
+  auto cpus = dataflow::numa_ordered_cpus();
+  auto cost = dataflow::measure_cost(p, 3);
+  auto parts = dataflow::partition(p, cpus.size(), cost);
+
+  std::cout << "Nodes: " << ptrs.size() << ", partitions: " << cpus.size()
+            << ", cut edges: " << parts.cut_edges << '\n';
+
+  auto serial = time_runs(runs, [&p] { dataflow::run_serial(p); });
+  dataflow::parallel_runner runner{parts.parts.size(), cpus};
+  auto parallel =
+      time_runs(runs, [&p, &parts, &runner] { runner.run(p, parts); });
+  std::cout << "Serial:   " << serial << " ms/run\n";
+  std::cout << "Parallel: " << parallel << " ms/run (" << serial / parallel
+            << "x)" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "dataflow/dataflow.hpp"
+
+// Benchmark of building a graph, which probes every pair of nodes for
+// connections. Ports compare their integer type ids, the same probes are
+// repeated with the std::type_info comparison ports used before.
+
+class step : public dataflow::inputs<int>, public dataflow::outputs<int> {
+ public:
+  void operator()() override { outputs::get<0>() = inputs::get<0>() + 1; }
+};
+
+using int_port = dataflow::impl::single_port<int>;
+
+// The check single_port::connected_to made before ports had type ids
+bool connected_by_type_info(const dataflow::port& output,
+                            const dataflow::port& input) {
+  if (input.type() == output.type()) {
+    return static_cast<const int_port&>(output).port_data ==
+           dynamic_cast<const int_port&>(input).port_data;
+  }
+  return false;
+}
+
+// Best of a few runs, in milliseconds
+template <typename F>
+double time_ms(F&& f) {
+  double best = 0;
+  for (int i = 0; i < 5; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    if (i == 0 || ms < best) best = ms;
+  }
+  return best;
+}
+
+int main(int, char**) {
+  constexpr std::size_t length = 2000;
+
+  std::vector<std::unique_ptr<step>> chain;
+  std::vector<dataflow::node*> ptrs;
+  for (std::size_t i = 0; i < length; ++i) {
+    chain.push_back(std::make_unique<step>());
+    if (i > 0) chain[i]->input(0) = std::as_const(*chain[i - 1]).output(0);
+    ptrs.push_back(chain.back().get());
+  }
+
+  std::size_t edges = 0;
+  auto build = time_ms([&] {
+    dataflow::graph g{ptrs};
+    edges = 0;
+    for (auto&& [_, deps] : g.adjacency()) edges += deps.size();
+  });
+
+  // the probes made while building, with either way of checking the type
+  auto probe = [&ptrs](auto&& connected) {
+    std::size_t matches = 0;
+    for (auto* n : ptrs) {
+      for (auto* m : ptrs) {
+        const auto& input = std::as_const(*n).input(0);
+        const auto& output = std::as_const(*m).output(0);
+        if (connected(output, input)) ++matches;
+      }
+    }
+    return matches;
+  };
+  std::size_t matches = 0;
+  auto by_id = time_ms([&] {
+    matches = probe([](const dataflow::port& output,
+                       const dataflow::port& input) {
+      return output.connected_to(input);
+    });
+  });
+  auto by_type_info = time_ms([&] { probe(connected_by_type_info); });
+
+  std::cout << "Nodes: " << length << ", edges: " << edges << '\n';
+  std::cout << "Graph build:        " << build << " ms\n";
+  std::cout << "Probes (type id):   " << by_id << " ms, " << matches
+            << " connected\n";
+  std::cout << "Probes (type_info): " << by_type_info << " ms ("
+            << by_type_info / by_id << "x)" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <map>
 #include <memory>
+#include <set>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -9,6 +11,7 @@
 #include <nlohmann/json.hpp>
 
 #include "dataflow/api.hpp"
+#include "dataflow/graph.hpp"
 #include "dataflow/node.hpp"
 
 namespace dataflow {
@@ -20,6 +23,13 @@ class DATAFLOW_EXPORT factory {
 
   [[nodiscard]] virtual std::unique_ptr<node> create(
       const nlohmann::json& config) const = 0;
+  // Creates an independent copy of a node made by this factory. Override when
+  // a node can share expensive state with the original instead of being
+  // recreated from its config.
+  [[nodiscard]] virtual std::unique_ptr<node> clone(
+      const node&, const nlohmann::json& config) const {
+    return create(config);
+  }
   [[nodiscard]] virtual nlohmann::json schema() const { return {}; }
   [[nodiscard]] std::string node_type() const;
 
@@ -62,6 +72,9 @@ class DATAFLOW_EXPORT registry {
 
   static std::unique_ptr<node> create(const std::string& type,
                                       const nlohmann::json& config);
+  static std::unique_ptr<node> clone(const std::string& type,
+                                     const node& original,
+                                     const nlohmann::json& config);
 
   static nlohmann::json schema();
 
@@ -101,8 +114,39 @@ class DATAFLOW_EXPORT builder {
   builder& operator=(const builder&) = delete;
 
   [[nodiscard]] std::vector<node*> nodes() const;
+  [[nodiscard]] node& get(int id) const;
+  // Ids of all nodes in ascending order
+  [[nodiscard]] std::vector<int> ids() const;
+  // Dependencies of every node, taken from the link table
+  [[nodiscard]] std::map<node*, std::set<node*>> adjacency() const;
+
+  // Independent copy of every node, linked the same way. The parsed config is
+  // shared with the copy.
+  [[nodiscard]] std::unique_ptr<builder> clone() const;
+
+  // Edits that keep the link table and a graph built from these nodes in sync
+  void add(int id, const std::string& type, const nlohmann::json& data,
+           graph& g);
+  void remove(int id, graph& g);
+  void connect(int from_id, int from_port, int to_id, int to_port, graph& g);
+  void disconnect(int from_id, int from_port, int to_id, int to_port,
+                  graph& g);
+  // Recreates a node from a new config, keeping its links
+  void reconfigure(int id, const nlohmann::json& data, graph& g);
 
  private:
+  struct node_config {
+    std::string type;
+    nlohmann::json data;
+  };
+  struct link;
+  struct link_table;
+
+  builder() = default;
+  void link_nodes();
+
   std::map<int, std::unique_ptr<node>> node_map;
+  std::shared_ptr<const std::map<int, node_config>> configs;
+  std::shared_ptr<const link_table> links;
 };
 }  // namespace dataflow
@@ -1,6 +1,11 @@
 #pragma once
 
 #include "dataflow/builder.hpp"
+#include "dataflow/executor.hpp"
 #include "dataflow/graph.hpp"
 #include "dataflow/node.hpp"
+#include "dataflow/partition.hpp"
+#include "dataflow/plan.hpp"
+#include "dataflow/pool.hpp"
 #include "dataflow/runtime.hpp"
+#include "dataflow/snapshot.hpp"
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "dataflow/api.hpp"
+#include "dataflow/plan.hpp"
+
+namespace dataflow {
+struct run_options {
+  // Share of the workers relative to the other runs
+  double weight = 1.0;
+  // Most nodes of the run executing at the same time, 0 for no limit
+  std::size_t max_parallel = 0;
+};
+
+// Worker pool shared by many graphs. The ready nodes of every submitted run
+// are interleaved on the workers, picking the run that has received the
+// smallest share of work relative to its weight (stride scheduling), so a
+// heavy run cannot starve the others.
+class DATAFLOW_EXPORT executor {
+  struct anchor;
+  struct run_state;
+
+ public:
+  class DATAFLOW_EXPORT run_handle {
+   public:
+    // Throws the first exception of a node, or when the run was cancelled
+    [[nodiscard]] const std::shared_future<void>& completion() const;
+    void wait() const;
+    // Nodes already running finish, no new ones are started. Does nothing
+    // once the executor is destroyed, which completes every run.
+    void cancel();
+
+   private:
+    friend class executor;
+    run_handle(std::shared_ptr<anchor> owner, std::shared_ptr<run_state> state,
+               std::shared_future<void> future);
+
+    std::shared_ptr<anchor> owner;
+    std::shared_ptr<run_state> state;
+    std::shared_future<void> future;
+  };
+
+  explicit executor(std::size_t workers = std::thread::hardware_concurrency());
+  ~executor();
+
+  executor(const executor&) = delete;
+  executor& operator=(const executor&) = delete;
+
+  // Takes the order of p right away, throwing validation_error if it cannot
+  // run. Runs of the same plan are queued behind each other.
+  run_handle submit(plan& p, run_options options = {});
+  // Waits until no run of p is queued or active. The graph of p can then be
+  // edited until the next submit.
+  void drain(const plan& p);
+
+ private:
+  void work();
+  void activate(const std::shared_ptr<run_state>& run);
+  void finish(const std::shared_ptr<run_state>& run);
+  void cancel(const std::shared_ptr<run_state>& run);
+
+  std::shared_ptr<anchor> self;
+  std::mutex mutex;
+  std::condition_variable changed;
+  bool stopping = false;
+  std::vector<std::shared_ptr<run_state>> active;
+  std::map<plan*, std::deque<std::shared_ptr<run_state>>> waiting;
+  std::vector<std::thread> threads;
+};
+}  // namespace dataflow
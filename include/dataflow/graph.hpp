@@ -1,8 +1,13 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <map>
+#include <optional>
 #include <ostream>
 #include <set>
+#include <utility>
 #include <vector>
 
 #include "dataflow/api.hpp"
@@ -13,12 +18,61 @@ class DATAFLOW_EXPORT graph {
  public:
   explicit graph(const std::vector<node*>& nodes);
   explicit graph(std::initializer_list<node*> nodes);
+  // Takes already known dependencies instead of probing every pair of nodes
+  explicit graph(std::map<node*, std::set<node*>> adjacency);
 
   [[nodiscard]] const std::map<node*, std::set<node*>>& adjacency() const;
+  [[nodiscard]] const std::set<node*>& successors(node* n) const;
+  // Execution order, kept up to date by the edits below
+  [[nodiscard]] std::vector<node*> order() const;
+  // Incremented by every edit
+  [[nodiscard]] std::uint64_t revision() const;
+  // Nodes whose inputs or dependencies changed after revision r, nullopt if r
+  // is too old for the changes to still be known
+  [[nodiscard]] std::optional<std::vector<node*>> changed_since(
+      std::uint64_t r) const;
+
+  // Incremental edits. Each one only updates the dependencies and the order
+  // around the nodes involved. They must not be applied while the graph is
+  // being run, see executor::drain.
+
+  // Adds a node, picking up connections it already has to the graph. Probes
+  // every node of the graph.
+  void insert(node* n);
+  // Adds a node that reads from dependencies and that no node of the graph
+  // reads from yet, without probing
+  void insert(node* n, const std::set<node*>& dependencies);
+  // Removes a node and disconnects the inputs that read from it
+  void erase(node* n);
+  // Throws and leaves the graph unchanged if the connection would create a
+  // cycle
+  void connect(node& from, std::size_t output, node& to, std::size_t input);
+  void disconnect(node& from, std::size_t output, node& to, std::size_t input);
+  // Swaps in a node that is already connected the same way as old_node
+  void replace(node* old_node, node* new_node);
 
   void dump(std::ostream& out) const;
 
  private:
+  void sort();
+  void add_edge(node* from, node* to);
+  void remove_edge(node* from, node* to);
+  void append(node* n);
+  void detach(node* n);
+  void note(node* n);
+  void require(node* n) const;
+
+  static constexpr std::size_t max_logged_changes = 4096;
+
   std::map<node*, std::set<node*>> adj_list;
+  std::map<node*, std::set<node*>> succ_list;
+  // Ranks only need to be increasing along the execution order, so edits can
+  // leave gaps between them
+  std::map<node*, std::uint64_t> rank;
+  std::map<std::uint64_t, node*> ranked;
+  std::uint64_t revision_count = 0;
+  // (revision, node) of recent changes, see changed_since
+  std::deque<std::pair<std::uint64_t, node*>> change_log;
+  std::uint64_t forgotten = 0;
 };
 }  // namespace dataflow
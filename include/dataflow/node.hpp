@@ -1,31 +1,117 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iterator>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 #include <typeinfo>
+#include <utility>
 #include <vector>
 
 #include "dataflow/api.hpp"
 
 namespace dataflow {
 
+// Compact identifier of a type, derived from its name so that it is the same
+// in every shared library built with the same compiler, unlike the address of
+// a std::type_info. Ports trust the id alone, so types in an anonymous
+// namespace are rejected: equally named ones from different translation units
+// would get the same id.
+using type_id = std::uint64_t;
+
+template <typename T>
+constexpr type_id type_id_of() {
+#if defined(_MSC_VER) && !defined(__clang__)
+  constexpr std::string_view name = __FUNCSIG__;
+#else
+  constexpr std::string_view name = __PRETTY_FUNCTION__;
+#endif
+  static_assert(name.find("{anonymous}") == std::string_view::npos &&
+                    name.find("(anonymous namespace)") ==
+                        std::string_view::npos &&
+                    name.find("`anonymous namespace'") ==
+                        std::string_view::npos,
+                "Port values cannot be types from an anonymous namespace");
+  // FNV-1a
+  type_id hash = 0xcbf29ce484222325ULL;
+  for (char c : name) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+template <typename T>
+inline constexpr type_id type_id_v = type_id_of<T>();
+
 struct DATAFLOW_EXPORT port {
   std::string label;
 
+  // Ports without an id only connect through their own try_connect
+  port() = default;
+  explicit port(type_id id) : port_id{id} {}
   virtual ~port() {}
   virtual const std::type_info& type() const = 0;
+  // Ports can only be connected if their ids match, see type_id_of
+  [[nodiscard]] type_id id() const { return port_id; }
+  [[nodiscard]] virtual bool empty() const {
+    throw std::runtime_error("Port " + label + " does not support empty");
+  }
+  // Whether an input port has to be connected for its node to run
+  [[nodiscard]] virtual bool required() const { return false; }
+  // Number of distinct outputs an input port reads from
+  [[nodiscard]] virtual std::size_t connections() const {
+    return empty() ? 0 : 1;
+  }
   virtual void try_connect(const port& other) = 0;
   virtual bool connected_to(const port& other) const = 0;
+  // Drops the connection to other, if any
+  virtual void disconnect(const port&) {
+    throw std::runtime_error("Port " + label + " does not support disconnect");
+  }
+  // Called by the runtime once the owning node has finished running
+  virtual void publish() {}
+  // Copies the value of an output port into storage allocated by the calling
+  // thread, so that first-touch places it on that thread's NUMA node. Readers
+  // stay connected.
+  virtual void relocate() {}
+  // Bytes held by the value of an output port, including what it owns on the
+  // heap when that can be told, see impl::footprint. 0 if unknown.
+  [[nodiscard]] virtual std::size_t buffer_size() const { return 0; }
+  // New output port of a type this port can be connected to
+  [[nodiscard]] virtual std::unique_ptr<port> make_source() const {
+    throw std::runtime_error("Port " + label + " cannot make a source");
+  }
+
+  [[nodiscard]] virtual bool serializable() const { return false; }
+  virtual void save(std::string&) const {
+    throw std::runtime_error("No serializer for port " + label);
+  }
+  virtual void load(std::string_view) {
+    throw std::runtime_error("No serializer for port " + label);
+  }
 
   port& operator=(const port& other) {
     try_connect(other);
     return *this;
   }
+
+ private:
+  type_id port_id = 0;
 };
 
+class registry;
+
 class DATAFLOW_EXPORT node {
  public:
   virtual ~node() = default;
@@ -50,6 +136,10 @@ class DATAFLOW_EXPORT node {
   [[nodiscard]] bool output_connected_to(const node& other) const;
   [[nodiscard]] bool input_connected_to(const node& other) const;
 
+  void publish();
+  // See port::relocate
+  void relocate();
+
   void set_label(const std::string& label);
   DATAFLOW_DEPRECATED void set_input_label(std::size_t i,
                                            const std::string& label);
@@ -63,12 +153,39 @@ class DATAFLOW_EXPORT node {
   [[nodiscard]] port& output(std::size_t i);
 
  private:
+  friend class registry;
+  // Node and port labels, for clones
+  void copy_labels(const node& original);
+
   std::string node_label;
 
   std::vector<std::unique_ptr<port>> input_ports;
   std::vector<std::unique_ptr<port>> output_ports;
 };
 
+// Converts port values to flat bytes and back. Trivially copyable types are
+// copied as is, other types can be supported by specializing this template
+// with the same members.
+template <typename T, typename = void>
+struct serializer {
+  static constexpr bool enabled = false;
+};
+
+template <typename T>
+struct serializer<T, std::enable_if_t<std::is_trivially_copyable_v<T>>> {
+  static constexpr bool enabled = true;
+
+  static void save(const T& value, std::string& out) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+  static void load(T& value, std::string_view in) {
+    if (in.size() != sizeof(T)) {
+      throw std::runtime_error("Serialized value has the wrong size");
+    }
+    std::memcpy(&value, in.data(), sizeof(T));
+  }
+};
+
 namespace impl {
 template <typename T>
 struct single_port;
@@ -76,31 +193,96 @@ struct single_port;
 template <typename T>
 struct multi_port;
 
+// Whether p is a P, by id only so that it also holds for ports created in
+// another shared library
+template <typename P>
+bool is(const port& p) {
+  return p.id() == type_id_v<P>;
+}
+
+template <typename T, typename = void>
+struct has_capacity : std::false_type {};
+
+template <typename T>
+struct has_capacity<T, std::void_t<typename T::value_type,
+                                   decltype(std::declval<const T&>().capacity())>>
+    : std::true_type {};
+
+// Size of a value plus the storage of containers that report a capacity
+template <typename T>
+std::size_t footprint(const T& value) {
+  if constexpr (has_capacity<T>::value) {
+    return sizeof(T) + value.capacity() * sizeof(typename T::value_type);
+  } else {
+    return sizeof(T);
+  }
+}
+
 template <typename T>
 struct single_port : public port {
-  single_port() {}
+  single_port() : port{type_id_v<single_port<T>>} {}
   // Overload to default-initialize data so it can be assigned to
-  explicit single_port(bool) : port_data{new T{}} {}
+  explicit single_port(bool)
+      : port{type_id_v<single_port<T>>}, port_data{new T{}} {}
   [[nodiscard]] const std::type_info& type() const override {
     return typeid(single_port<T>);
   }
-  [[nodiscard]] bool empty() const { return port_data == nullptr; }
+  [[nodiscard]] bool empty() const override { return port_data == nullptr; }
+  [[nodiscard]] bool required() const override { return true; }
   [[nodiscard]] bool connected_to(const port& other) const override {
-    if (other.type() == type()) {
-      return port_data == dynamic_cast<const single_port&>(other).port_data;
-    } else if (other.type() == typeid(multi_port<T>)) {
-      return dynamic_cast<const multi_port<T>&>(other).connected_to(*this);
+    if (is<single_port<T>>(other)) {
+      return port_data == static_cast<const single_port&>(other).port_data;
+    } else if (is<multi_port<T>>(other)) {
+      return static_cast<const multi_port<T>&>(other).connected_to(*this);
     }
     return false;
   }
 
   void try_connect(const port& other) override {
-    if (other.type() == type()) {
-      port_data = dynamic_cast<const single_port<T>&>(other).port_data;
+    if (is<single_port<T>>(other)) {
+      port_data = static_cast<const single_port<T>&>(other).port_data;
     } else {
       throw std::runtime_error("Cannot connect ports of incompatible types");
     }
   }
+  void disconnect(const port& other) override {
+    if (connected_to(other)) port_data.reset();
+  }
+  [[nodiscard]] std::unique_ptr<port> make_source() const override {
+    return std::make_unique<single_port<T>>(true);
+  }
+  [[nodiscard]] std::size_t buffer_size() const override {
+    return empty() ? 0 : footprint(*port_data);
+  }
+  void relocate() override {
+    if constexpr (std::is_copy_constructible_v<T> &&
+                  std::is_move_assignable_v<T>) {
+      if (empty()) return;
+      // the object stays where it is, what it owns is allocated again
+      T fresh(*port_data);
+      *port_data = std::move(fresh);
+    }
+  }
+
+  [[nodiscard]] bool serializable() const override {
+    return serializer<T>::enabled;
+  }
+  void save(std::string& out) const override {
+    if constexpr (serializer<T>::enabled) {
+      serializer<T>::save(data(), out);
+    } else {
+      port::save(out);
+    }
+  }
+  void load(std::string_view in) override {
+    if constexpr (serializer<T>::enabled) {
+      if (empty()) port_data = std::make_shared<T>();
+      serializer<T>::load(*port_data, in);
+    } else {
+      port::load(in);
+    }
+  }
+
   const T& data() const {
     if (empty()) {
       throw std::runtime_error("Cannot access data of an empty port");
@@ -119,14 +301,21 @@ struct single_port : public port {
 
 template <typename T>
 struct multi_port : public port {
+  multi_port() : port{type_id_v<multi_port<T>>} {}
   [[nodiscard]] const std::type_info& type() const override {
     return typeid(multi_port<T>);
   }
-  [[nodiscard]] bool empty() const { return port_data.empty(); }
+  [[nodiscard]] bool empty() const override { return port_data.empty(); }
+  [[nodiscard]] std::size_t connections() const override {
+    auto sources = port_data;
+    std::sort(sources.begin(), sources.end());
+    return std::unique(sources.begin(), sources.end()) - sources.begin();
+  }
   [[nodiscard]] bool connected_to(const port& other) const override {
-    if (other.type() == typeid(single_port<T>)) {
+    if (is<single_port<T>>(other)) {
+      const auto& source = static_cast<const single_port<T>&>(other).port_data;
       for (auto& conn : port_data) {
-        if (conn == dynamic_cast<const single_port<T>&>(other).port_data) {
+        if (conn == source) {
           return true;
         }
       }
@@ -135,13 +324,23 @@ struct multi_port : public port {
   }
 
   void try_connect(const port& other) override {
-    if (other.type() == typeid(single_port<T>)) {
-      port_data.push_back(dynamic_cast<const single_port<T>&>(other).port_data);
+    if (is<single_port<T>>(other)) {
+      port_data.push_back(static_cast<const single_port<T>&>(other).port_data);
     } else {
       throw std::runtime_error(
           "Can only connect a single port of same type to a multi port");
     }
   }
+  void disconnect(const port& other) override {
+    if (is<single_port<T>>(other)) {
+      const auto& source = static_cast<const single_port<T>&>(other).port_data;
+      port_data.erase(std::remove(port_data.begin(), port_data.end(), source),
+                      port_data.end());
+    }
+  }
+  [[nodiscard]] std::unique_ptr<port> make_source() const override {
+    return std::make_unique<single_port<T>>(true);
+  }
   std::vector<T> data() const {
     std::vector<T> return_data;
     for (auto& conn : port_data) {
@@ -160,11 +359,144 @@ struct multi_port : public port {
   std::vector<std::shared_ptr<T>> port_data;
 };
 
+// Output port that keeps N published copies of its value so that readers
+// outside of the graph can hold on to the results of run k while run k + 1 is
+// already writing to the port. Publishing is done by the (single) thread that
+// runs the owning node, readers may be on any thread.
+template <typename T, std::size_t N>
+struct buffered_port : public single_port<T> {
+  static_assert(N >= 2 && N <= 0xff,
+                "A buffered port needs between 2 and 255 buffers");
+
+ private:
+  struct buffer {
+    T value{};
+    mutable std::atomic<std::size_t> readers{0};
+  };
+
+ public:
+  // Pins a published buffer for as long as it is alive
+  class view {
+   public:
+    view() = default;
+    view(const view&) = delete;
+    view& operator=(const view&) = delete;
+    view(view&& other) noexcept
+        : buf{std::exchange(other.buf, nullptr)}, epoch_num{other.epoch_num} {}
+    view& operator=(view&& other) noexcept {
+      if (this != &other) {
+        release();
+        buf = std::exchange(other.buf, nullptr);
+        epoch_num = other.epoch_num;
+      }
+      return *this;
+    }
+    ~view() { release(); }
+
+    [[nodiscard]] explicit operator bool() const { return buf != nullptr; }
+    [[nodiscard]] const T& operator*() const { return buf->value; }
+    [[nodiscard]] const T* operator->() const { return &buf->value; }
+    [[nodiscard]] std::uint64_t epoch() const { return epoch_num; }
+
+   private:
+    friend struct buffered_port;
+    view(const buffer* b, std::uint64_t e) : buf{b}, epoch_num{e} {}
+
+    void release() {
+      if (buf != nullptr) buf->readers.fetch_sub(1);
+      buf = nullptr;
+    }
+
+    const buffer* buf = nullptr;
+    std::uint64_t epoch_num = 0;
+  };
+
+  explicit buffered_port(bool) : single_port<T>(true) {}
+
+  // Copies the current value into a buffer that no reader holds and swaps it
+  // in. If every other buffer is pinned the publication is skipped so the run
+  // never blocks on a reader.
+  void publish() override {
+    auto current = state.load();
+    auto current_idx = current & index_mask;
+    auto current_epoch = current >> index_bits;
+    for (std::size_t k = 1; k <= N; ++k) {
+      auto idx = (current_idx + k) % N;
+      if (idx == current_idx && current_epoch != 0) continue;
+      auto& b = buffers[idx];
+      if (b.readers.load() != 0) continue;
+      b.value = *this->port_data;
+      state.store(((current_epoch + 1) << index_bits) | idx);
+      return;
+    }
+  }
+
+  // Latest published value, empty if nothing was published yet
+  [[nodiscard]] view published() const {
+    for (;;) {
+      auto current = state.load();
+      if ((current >> index_bits) == 0) return {};
+      const auto& b = buffers[current & index_mask];
+      b.readers.fetch_add(1);
+      // The writer never touches the published buffer, so if it is still the
+      // published one after pinning it is safe to read until released
+      if (state.load() == current) return {&b, current >> index_bits};
+      b.readers.fetch_sub(1);
+    }
+  }
+
+  // Number of publications so far
+  [[nodiscard]] std::uint64_t epoch() const {
+    return state.load() >> index_bits;
+  }
+
+  [[nodiscard]] std::size_t buffer_size() const override {
+    auto size = single_port<T>::buffer_size();
+    for (const auto& b : buffers) size += footprint(b.value);
+    return size;
+  }
+
+ private:
+  static constexpr unsigned index_bits = 8;
+  static constexpr std::uint64_t index_mask = (1U << index_bits) - 1;
+
+  std::array<buffer, N> buffers;
+  // (epoch << index_bits) | index of the published buffer
+  std::atomic<std::uint64_t> state{0};
+};
+
+// Input port that may be left unconnected, see inputs::has
+template <typename T>
+struct optional_port : public single_port<T> {
+  [[nodiscard]] bool required() const override { return false; }
+};
+
+// Hot path accessors. Connections are checked once by the plan, see
+// dataflow::validate, so reads do not check again.
+template <typename T>
+const T& read(const single_port<T>& p) {
+  assert(!p.empty());
+  return *p.port_data;
+}
+
+template <typename T>
+std::vector<T> read(const multi_port<T>& p) {
+  return p.data();
+}
 }  // namespace impl
 
 template <typename T>
 struct many {};
 
+// Input that does not have to be connected
+template <typename T>
+struct optional {};
+
+// Output that can be read from outside the graph while the graph is running,
+// see outputs::published
+template <typename T, std::size_t N = 2>
+struct buffered {};
+
 template <typename T>
 struct port_traits {
   using type = T&;
@@ -179,6 +511,20 @@ struct port_traits<many<T>> {
   using port_type = impl::multi_port<T>;
 };
 
+template <typename T>
+struct port_traits<optional<T>> {
+  using type = T&;
+  using const_type = const T&;
+  using port_type = impl::optional_port<T>;
+};
+
+template <typename T, std::size_t N>
+struct port_traits<buffered<T, N>> {
+  using type = T&;
+  using const_type = const T&;
+  using port_type = impl::buffered_port<T, N>;
+};
+
 template <typename... Inputs>
 class inputs : public virtual node {
  public:
@@ -192,28 +538,30 @@ class inputs : public virtual node {
   using port_type =
       typename port_traits<std::tuple_element_t<i, tuple_type>>::port_type;
 
-  inputs()
-      : starting_idx{node::add_inputs(
-            {new typename port_traits<Inputs>::port_type...})} {}
+  inputs() : ports{new typename port_traits<Inputs>::port_type...} {
+    std::apply([this](auto*... p) { node::add_inputs({p...}); }, ports);
+  }
 
   template <std::size_t i>
   port_type<i>& connect() {
-    return dynamic_cast<port_type<i>&>(input(starting_idx + i));
+    return *std::get<i>(ports);
   }
 
  protected:
+  // Unchecked, required inputs are verified to be connected by the plan
   template <std::size_t i>
   const_type<i> get() const {
-    return dynamic_cast<const port_type<i>&>(input(starting_idx + i)).data();
+    return impl::read(*std::get<i>(ports));
   }
 
   template <std::size_t i>
   [[nodiscard]] bool has() const {
-    return !dynamic_cast<const port_type<i>&>(input(starting_idx + i)).empty();
+    return !std::get<i>(ports)->empty();
   }
 
  private:
-  std::size_t starting_idx;
+  // Owned by node, kept here to skip the lookup and cast on every access
+  std::tuple<typename port_traits<Inputs>::port_type*...> ports;
 };
 
 template <typename... Outputs>
@@ -226,22 +574,29 @@ class outputs : public virtual node {
   using port_type =
       typename port_traits<std::tuple_element_t<i, tuple_type>>::port_type;
 
-  outputs()
-      : starting_idx{node::add_outputs(
-            {new typename port_traits<Outputs>::port_type(true)...})} {}
+  outputs() : ports{new typename port_traits<Outputs>::port_type(true)...} {
+    std::apply([this](auto*... p) { node::add_outputs({p...}); }, ports);
+  }
 
   template <std::size_t i>
   [[nodiscard]] const port_type<i>& connect() const {
-    return dynamic_cast<const port_type<i>&>(output(starting_idx + i));
+    return *std::get<i>(ports);
+  }
+
+  // Last value published by a buffered<T> output
+  template <std::size_t i>
+  [[nodiscard]] auto published() const {
+    return connect<i>().published();
   }
 
  protected:
   template <std::size_t i>
   type<i> get() {
-    return dynamic_cast<port_type<i>&>(output(starting_idx + i)).data();
+    return std::get<i>(ports)->data();
   }
 
  private:
-  std::size_t starting_idx;
+  // Owned by node, kept here to skip the lookup and cast on every access
+  std::tuple<typename port_traits<Outputs>::port_type*...> ports;
 };
 }  // namespace dataflow
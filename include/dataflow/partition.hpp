@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "dataflow/api.hpp"
+#include "dataflow/node.hpp"
+#include "dataflow/plan.hpp"
+
+namespace dataflow {
+struct partitioning {
+  // Nodes of each partition, in execution order
+  std::vector<std::vector<node*>> parts;
+  std::map<node*, std::size_t> owner;
+  // Number of dependencies between nodes of different partitions
+  std::size_t cut_edges = 0;
+  // Graph revision the partitioning was computed for
+  std::uint64_t revision = 0;
+};
+
+// Average wall time in seconds of every node over a number of serial runs
+DATAFLOW_EXPORT std::map<node*, double> measure_cost(plan& p,
+                                                     std::size_t runs = 1);
+
+// Splits the nodes of a plan into count clusters of similar total cost while
+// keeping the number of dependencies that cross between clusters low. Nodes
+// without a cost are weighted as 1.
+DATAFLOW_EXPORT partitioning partition(const plan& p, std::size_t count,
+                                       const std::map<node*, double>& cost = {});
+
+// Online CPUs grouped by NUMA node, so that consecutive partitions are pinned
+// to the same socket before spilling over to the next one
+DATAFLOW_EXPORT std::vector<int> numa_ordered_cpus();
+}  // namespace dataflow
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "dataflow/api.hpp"
+#include "dataflow/graph.hpp"
+#include "dataflow/node.hpp"
+
+namespace dataflow {
+class DATAFLOW_EXPORT validation_error : public std::runtime_error {
+ public:
+  explicit validation_error(std::vector<std::string> problems);
+
+  [[nodiscard]] const std::vector<std::string>& problems() const;
+
+ private:
+  std::vector<std::string> problem_list;
+};
+
+// Every problem that would prevent g from running: required inputs that are
+// not connected, inputs connected to nodes outside of g and cycles. Port
+// types are already checked when connecting.
+DATAFLOW_EXPORT std::vector<std::string> validate(const graph& g);
+
+// Execution order of a graph, reused between runs until the graph is edited
+class DATAFLOW_EXPORT plan {
+ public:
+  // Throws validation_error if the graph cannot be run, which lets the nodes
+  // read their inputs without checking them
+  explicit plan(graph& g);
+
+  [[nodiscard]] graph& get_graph() const;
+  [[nodiscard]] const std::vector<node*>& order() const;
+
+  // Nodes required to compute targets, in execution order. The result is
+  // cached per set of targets.
+  [[nodiscard]] const std::vector<node*>& cone(std::vector<node*> targets);
+
+ private:
+  void refresh() const;
+
+  graph* g;
+  mutable std::uint64_t revision;
+  mutable std::vector<node*> sorted;
+  mutable std::map<std::vector<node*>, std::vector<node*>> cones;
+};
+}  // namespace dataflow
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "dataflow/api.hpp"
+#include "dataflow/builder.hpp"
+#include "dataflow/graph.hpp"
+#include "dataflow/plan.hpp"
+
+namespace dataflow {
+// Independent copies of a built graph that can be run concurrently, one per
+// worker thread
+class DATAFLOW_EXPORT instance_pool {
+  struct instance {
+    explicit instance(std::unique_ptr<builder> b);
+
+    std::unique_ptr<builder> nodes;
+    graph g;
+    plan p;
+  };
+
+ public:
+  // Exclusive use of one instance, returned to the pool on destruction
+  class DATAFLOW_EXPORT lease {
+   public:
+    lease(const lease&) = delete;
+    lease& operator=(const lease&) = delete;
+    lease(lease&& other) noexcept;
+    lease& operator=(lease&& other) noexcept;
+    ~lease();
+
+    [[nodiscard]] builder& nodes() const;
+    [[nodiscard]] graph& get_graph() const;
+    [[nodiscard]] plan& get_plan() const;
+
+   private:
+    friend class instance_pool;
+    lease(instance_pool* pool, instance* inst) : owner{pool}, inst{inst} {}
+
+    instance_pool* owner;
+    instance* inst;
+  };
+
+  instance_pool(const builder& prototype, std::size_t size);
+
+  instance_pool(const instance_pool&) = delete;
+  instance_pool& operator=(const instance_pool&) = delete;
+
+  // Blocks until an instance is free
+  [[nodiscard]] lease acquire();
+  [[nodiscard]] std::size_t size() const;
+
+ private:
+  void release(instance* inst);
+
+  std::vector<std::unique_ptr<instance>> instances;
+  std::vector<instance*> idle;
+  std::mutex mutex;
+  std::condition_variable available;
+};
+}  // namespace dataflow
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "dataflow/api.hpp"
+#include "dataflow/builder.hpp"
+
+namespace dataflow {
+// Runs a builder config split across several local processes (POSIX only).
+//
+// Every node may carry a "process" index next to its "id" (default 0).
+// Process 0 is the calling process, which also coordinates the runs; every
+// other index is a forked worker that runs its own nodes. All nodes are
+// created in the calling process before forking. Values
+// crossing processes are serialized with serializer<T> into shared memory
+// ring buffers of slot_size bytes per value.
+class DATAFLOW_EXPORT process_group {
+ public:
+  explicit process_group(const std::string& config_json,
+                         std::size_t slot_size = 1 << 16);
+  ~process_group();
+
+  process_group(const process_group&) = delete;
+  process_group& operator=(const process_group&) = delete;
+
+  // One evaluation of the whole graph. Throws if a node throws or a worker
+  // exits, after which the group can no longer be run.
+  void run();
+
+  // Nodes assigned to process 0
+  [[nodiscard]] builder& local() const;
+  [[nodiscard]] std::size_t size() const;
+
+ private:
+  struct state;
+  std::unique_ptr<state> shared;
+};
+}  // namespace dataflow
@@ -1,8 +1,131 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "dataflow/api.hpp"
 #include "dataflow/graph.hpp"
+#include "dataflow/partition.hpp"
+#include "dataflow/plan.hpp"
 
 namespace dataflow {
 DATAFLOW_EXPORT void run_serial(graph& g);
-}  // namespace dataflow
\ No newline at end of file
+DATAFLOW_EXPORT void run_serial(plan& p);
+
+// Runs only the nodes that targets depend on
+DATAFLOW_EXPORT void run_for(plan& p, std::vector<node*> targets);
+
+// Runs every partition on its own thread, pinned to cpus[i % cpus.size()]
+// when cpus is not empty. A node only waits for dependencies that live in
+// another partition. The threads are started for every call, parallel_runner
+// keeps them across runs.
+DATAFLOW_EXPORT void run_parallel(plan& p, const partitioning& parts,
+                                  const std::vector<int>& cpus = {});
+
+// Persistent workers for run_parallel. Worker k pins itself to
+// cpus[k % cpus.size()] before it runs anything and then runs partition k of
+// every run. On the first run of a plan or partitioning, pinned workers move
+// the output values of their nodes to memory they allocate themselves, see
+// port::relocate.
+class DATAFLOW_EXPORT parallel_runner {
+ public:
+  explicit parallel_runner(std::size_t workers, std::vector<int> cpus = {});
+  ~parallel_runner();
+
+  parallel_runner(const parallel_runner&) = delete;
+  parallel_runner& operator=(const parallel_runner&) = delete;
+
+  [[nodiscard]] std::size_t size() const;
+  // Same as run_parallel, parts may not have more partitions than workers
+  void run(plan& p, const partitioning& parts);
+
+ private:
+  void work(std::size_t k, int cpu);
+
+  std::mutex run_mutex;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  std::function<void(std::size_t)> job;
+  std::uint64_t generation = 0;
+  std::size_t running = 0;
+  bool stopping = false;
+  bool pinned;
+  const plan* placed = nullptr;
+  std::uint64_t placed_revision = 0;
+  std::vector<std::thread> threads;
+};
+
+struct deadline_report {
+  // Time from the start of the run until each node with a deadline finished
+  std::map<node*, std::chrono::nanoseconds> latency;
+  // Nodes that finished after their deadline
+  std::vector<node*> missed;
+};
+
+// Runs the whole graph, always picking the ready node with the least slack.
+// Deadlines, relative to the start of the run, are propagated backwards
+// through the dependencies using the node costs in seconds (see
+// measure_cost), nodes without a cost count as 0. Nodes that no deadline
+// depends on run last.
+DATAFLOW_EXPORT deadline_report run_prioritized(
+    plan& p, const std::map<node*, std::chrono::nanoseconds>& deadlines,
+    const std::map<node*, double>& cost = {});
+
+struct allocation_stats {
+  std::uint64_t invocations = 0;
+  // Heap activity while the node and its publication were running
+  std::uint64_t allocations = 0;
+  std::uint64_t bytes = 0;
+  std::uint64_t deallocations = 0;
+  // Sum of the output port buffer sizes after the last invocation
+  std::size_t port_bytes = 0;
+};
+
+using allocation_profile = std::map<node*, allocation_stats>;
+
+// Whether the library was built with DATAFLOW_TRACK_ALLOCATIONS. Without it
+// heap activity is not counted and only invocations and port sizes are
+// filled in.
+[[nodiscard]] DATAFLOW_EXPORT bool allocation_tracking_enabled();
+
+namespace impl {
+// Runs n and publishes its outputs. Every runtime runs its nodes through here
+// so that an allocation_recorder sees all of them.
+DATAFLOW_EXPORT void invoke(node& n);
+}  // namespace impl
+
+// Adds the activity of every node run by any runtime, on any thread, to
+// profile while it is alive. Only one recorder can be alive at a time, and it
+// must outlive the runs it records.
+class DATAFLOW_EXPORT allocation_recorder {
+ public:
+  explicit allocation_recorder(allocation_profile& profile);
+  ~allocation_recorder();
+
+  allocation_recorder(const allocation_recorder&) = delete;
+  allocation_recorder& operator=(const allocation_recorder&) = delete;
+
+ private:
+  friend void impl::invoke(node& n);
+  void record(node& n, const allocation_stats& run);
+
+  allocation_profile& profile;
+  std::mutex mutex;
+};
+
+// Same as run_serial(p) with an allocation_recorder for profile
+DATAFLOW_EXPORT void run_serial(plan& p, allocation_profile& profile);
+
+// One line per node, heaviest allocators first, named by the node labels
+DATAFLOW_EXPORT void report_allocations(const allocation_profile& profile,
+                                        std::ostream& out);
+}  // namespace dataflow
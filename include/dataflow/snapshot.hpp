@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "dataflow/api.hpp"
+#include "dataflow/builder.hpp"
+
+namespace dataflow {
+// Output values of every node of b, keyed by node id and port index, in the
+// snapshot file format. Ports without a serializer<T> are left out.
+DATAFLOW_EXPORT std::string capture_snapshot(const builder& b);
+
+DATAFLOW_EXPORT void save_snapshot(const builder& b, const std::string& path);
+
+// Loads the values of a snapshot file into the ports that still exist with
+// the same type, memory-mapping the file where possible. Returns the number of
+// ports restored.
+DATAFLOW_EXPORT std::size_t restore_snapshot(builder& b,
+                                             const std::string& path);
+
+// Takes snapshots on the calling thread, which only serializes the values,
+// and writes them to disk on a background thread. A capture that is still
+// waiting to be written is replaced by a newer one.
+class DATAFLOW_EXPORT snapshot_writer {
+ public:
+  explicit snapshot_writer(std::string path);
+  ~snapshot_writer();
+
+  snapshot_writer(const snapshot_writer&) = delete;
+  snapshot_writer& operator=(const snapshot_writer&) = delete;
+
+  void capture(const builder& b);
+  // Waits until every capture has been written. Throws if the latest write
+  // failed.
+  void flush();
+
+ private:
+  void write_loop();
+
+  std::string path;
+  std::string pending;
+  bool has_pending = false;
+  bool writing = false;
+  bool write_failed = false;
+  bool stopping = false;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::thread worker;
+};
+}  // namespace dataflow
@@ -0,0 +1,153 @@
+#include "dataflow/runtime.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace dataflow {
+namespace {
+struct counters {
+  std::uint64_t allocations = 0;
+  std::uint64_t bytes = 0;
+  std::uint64_t deallocations = 0;
+};
+
+// Set while a profiled node runs on this thread. A plain pointer so that
+// reading it from operator new never allocates.
+thread_local counters* tracked = nullptr;
+
+std::atomic<allocation_recorder*> active_recorder{nullptr};
+
+#ifdef DATAFLOW_TRACK_ALLOCATIONS
+void* allocate(std::size_t size) {
+  if (auto* c = tracked) {
+    ++c->allocations;
+    c->bytes += size;
+  }
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+void deallocate(void* ptr) noexcept {
+  if (ptr == nullptr) return;
+  if (auto* c = tracked) ++c->deallocations;
+  std::free(ptr);
+}
+#endif
+}  // namespace
+
+bool allocation_tracking_enabled() {
+#ifdef DATAFLOW_TRACK_ALLOCATIONS
+  return true;
+#else
+  return false;
+#endif
+}
+
+void impl::invoke(node& n) {
+  auto* recorder = active_recorder.load(std::memory_order_acquire);
+  if (recorder == nullptr) {
+    n();
+    n.publish();
+    return;
+  }
+
+  counters c;
+  tracked = &c;
+  try {
+    n();
+    n.publish();
+  } catch (...) {
+    tracked = nullptr;
+    throw;
+  }
+  tracked = nullptr;
+
+  allocation_stats run{1, c.allocations, c.bytes, c.deallocations, 0};
+  for (std::size_t i = 0; i < n.output_size(); ++i) {
+    run.port_bytes += std::as_const(n).output(i).buffer_size();
+  }
+  recorder->record(n, run);
+}
+
+allocation_recorder::allocation_recorder(allocation_profile& profile)
+    : profile{profile} {
+  allocation_recorder* expected = nullptr;
+  if (!active_recorder.compare_exchange_strong(expected, this)) {
+    throw std::runtime_error("Another allocation_recorder is alive");
+  }
+}
+
+allocation_recorder::~allocation_recorder() { active_recorder.store(nullptr); }
+
+void allocation_recorder::record(node& n, const allocation_stats& run) {
+  std::lock_guard lock{mutex};
+  auto& stats = profile[&n];
+  stats.invocations += run.invocations;
+  stats.allocations += run.allocations;
+  stats.bytes += run.bytes;
+  stats.deallocations += run.deallocations;
+  stats.port_bytes = run.port_bytes;
+}
+
+void run_serial(plan& p, allocation_profile& profile) {
+  allocation_recorder recorder{profile};
+  run_serial(p);
+}
+
+void report_allocations(const allocation_profile& profile, std::ostream& out) {
+  std::vector<std::pair<node*, allocation_stats>> rows{profile.begin(),
+                                                       profile.end()};
+  std::stable_sort(rows.begin(), rows.end(), [](auto& a, auto& b) {
+    return a.second.bytes > b.second.bytes;
+  });
+  out << std::left << std::setw(24) << "node" << std::right << std::setw(12)
+      << "runs" << std::setw(12) << "allocs" << std::setw(14) << "bytes"
+      << std::setw(12) << "frees" << std::setw(14) << "port bytes" << '\n';
+  for (const auto& [n, stats] : rows) {
+    auto name = n->label().empty() ? std::string{"<unnamed>"} : n->label();
+    out << std::left << std::setw(24) << name << std::right << std::setw(12)
+        << stats.invocations << std::setw(12) << stats.allocations
+        << std::setw(14) << stats.bytes << std::setw(12)
+        << stats.deallocations << std::setw(14) << stats.port_bytes << '\n';
+  }
+}
+}  // namespace dataflow
+
+#ifdef DATAFLOW_TRACK_ALLOCATIONS
+// Replacements of the global allocation functions. Over-aligned allocations
+// keep the default implementation and are not counted.
+void* operator new(std::size_t size) {
+  if (auto* ptr = dataflow::allocate(size)) return ptr;
+  throw std::bad_alloc{};
+}
+void* operator new[](std::size_t size) {
+  if (auto* ptr = dataflow::allocate(size)) return ptr;
+  throw std::bad_alloc{};
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return dataflow::allocate(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return dataflow::allocate(size);
+}
+void operator delete(void* ptr) noexcept { dataflow::deallocate(ptr); }
+void operator delete[](void* ptr) noexcept { dataflow::deallocate(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept {
+  dataflow::deallocate(ptr);
+}
+void operator delete[](void* ptr, std::size_t) noexcept {
+  dataflow::deallocate(ptr);
+}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  dataflow::deallocate(ptr);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  dataflow::deallocate(ptr);
+}
+#endif
@@ -1,6 +1,72 @@
 #include "dataflow/builder.hpp"
 
+#include <algorithm>
+#include <set>
+#include <tuple>
+#include <utility>
+
 namespace dataflow {
+struct builder::link {
+  int from_id;
+  int from_port;
+  int to_id;
+  int to_port;
+};
+
+// Every link is kept twice, ordered by target and by source, so that the links
+// of a node or of one of its ports are found without scanning the table
+struct builder::link_table {
+  template <bool by_target>
+  struct order {
+    using is_transparent = void;
+
+    static std::tuple<int, int, int, int> key(const link& l) {
+      if constexpr (by_target) {
+        return {l.to_id, l.to_port, l.from_id, l.from_port};
+      } else {
+        return {l.from_id, l.from_port, l.to_id, l.to_port};
+      }
+    }
+    static std::pair<int, int> end(const link& l) {
+      return {std::get<0>(key(l)), std::get<1>(key(l))};
+    }
+
+    bool operator()(const link& a, const link& b) const {
+      return key(a) < key(b);
+    }
+    // links of a node
+    bool operator()(const link& a, int id) const { return end(a).first < id; }
+    bool operator()(int id, const link& b) const { return id < end(b).first; }
+    // links of a port, as (node id, port)
+    bool operator()(const link& a, const std::pair<int, int>& p) const {
+      return end(a) < p;
+    }
+    bool operator()(const std::pair<int, int>& p, const link& b) const {
+      return p < end(b);
+    }
+  };
+
+  void insert(const link& l) {
+    into.insert(l);
+    out_of.insert(l);
+  }
+  void erase(const link& l) {
+    into.erase(l);
+    out_of.erase(l);
+  }
+
+  std::set<link, order<true>> into;
+  std::set<link, order<false>> out_of;
+};
+
+namespace {
+// Copy on write for tables shared with clones
+template <typename T>
+T& writable(std::shared_ptr<const T>& ptr) {
+  if (ptr.use_count() > 1) ptr = std::make_shared<T>(*ptr);
+  return const_cast<T&>(*ptr);
+}
+}  // namespace
 
 std::string factory::node_type() const { return type; }
 
@@ -42,6 +108,20 @@ std::unique_ptr<node> registry::create(const std::string& type,
   return ptr;
 }
 
+std::unique_ptr<node> registry::clone(const std::string& type,
+                                      const node& original,
+                                      const nlohmann::json& config) {
+  auto& inst = instance();
+  auto it = inst.factories.find(type);
+  if (it == inst.factories.end()) {
+    throw std::runtime_error("Unknown node type: " + type);
+  }
+
+  auto ptr = it->second->clone(original, config);
+  ptr->copy_labels(original);
+  return ptr;
+}
+
 nlohmann::json registry::schema() {
   nlohmann::json result;
   for (auto&& [_, factory] : instance().factories) {
@@ -54,6 +134,7 @@ builder::builder(std::istream&& config_reader) {
   using namespace nlohmann;
 
   json config = json::parse(config_reader);
+  auto node_configs = std::make_shared<std::map<int, node_config>>();
   for (auto&& node : config["nodes"]) {
     int id = node["id"];
     std::string type = node["type"];
@@ -65,15 +146,35 @@ builder::builder(std::istream&& config_reader) {
                                std::to_string(id) + " (" + type +
                                "): " + e.what());
     }
+    node_configs->emplace(id, node_config{type, config});
   }
+  auto table = std::make_shared<link_table>();
   for (auto&& link : config["links"]) {
-    int from_id = link["from"]["id"];
-    int from_port = link["from"]["port"];
-    int to_id = link["to"]["id"];
-    int to_port = link["to"]["port"];
-    node_map.at(to_id)->input(to_port) =
-        std::as_const(*node_map.at(from_id)).output(from_port);
+    table->insert({link["from"]["id"], link["from"]["port"], link["to"]["id"],
+                   link["to"]["port"]});
+  }
+  configs = std::move(node_configs);
+  links = std::move(table);
+  link_nodes();
+}
+
+void builder::link_nodes() {
+  for (auto&& l : links->into) {
+    node_map.at(l.to_id)->input(l.to_port) =
+        std::as_const(*node_map.at(l.from_id)).output(l.from_port);
+  }
+}
+
+std::unique_ptr<builder> builder::clone() const {
+  std::unique_ptr<builder> result{new builder()};
+  result->configs = configs;
+  result->links = links;
+  for (auto&& [id, config] : *configs) {
+    result->node_map.emplace(
+        id, registry::clone(config.type, *node_map.at(id), config.data));
   }
+  result->link_nodes();
+  return result;
 }
 
 std::vector<node*> builder::nodes() const {
@@ -84,4 +185,97 @@ std::vector<node*> builder::nodes() const {
   return result;
 }
 
-}  // namespace dataflow
\ No newline at end of file
+node& builder::get(int id) const { return *node_map.at(id); }
+
+std::vector<int> builder::ids() const {
+  std::vector<int> result;
+  result.reserve(node_map.size());
+  for (auto&& [id, _] : node_map) {
+    result.push_back(id);
+  }
+  return result;
+}
+
+std::map<node*, std::set<node*>> builder::adjacency() const {
+  std::map<node*, std::set<node*>> result;
+  for (auto&& [_, ptr] : node_map) {
+    result[ptr.get()];
+  }
+  for (auto&& l : links->into) {
+    result[node_map.at(l.to_id).get()].insert(node_map.at(l.from_id).get());
+  }
+  return result;
+}
+
+void builder::add(int id, const std::string& type, const nlohmann::json& data,
+                  graph& g) {
+  if (node_map.count(id) != 0) {
+    throw std::runtime_error("Node " + std::to_string(id) + " already exists");
+  }
+  auto ptr = registry::create(type, data);
+  // a new node is not connected to anything yet
+  g.insert(ptr.get(), {});
+  node_map.emplace(id, std::move(ptr));
+  writable(configs).emplace(id, node_config{type, data});
+}
+
+void builder::remove(int id, graph& g) {
+  g.erase(node_map.at(id).get());
+  auto& table = writable(links);
+  auto [into_first, into_last] = table.into.equal_range(id);
+  auto [out_first, out_last] = table.out_of.equal_range(id);
+  std::vector<link> dropped{into_first, into_last};
+  dropped.insert(dropped.end(), out_first, out_last);
+  for (auto&& l : dropped) {
+    table.erase(l);
+  }
+  node_map.erase(id);
+  writable(configs).erase(id);
+}
+
+void builder::connect(int from_id, int from_port, int to_id, int to_port,
+                      graph& g) {
+  g.connect(*node_map.at(from_id), from_port, *node_map.at(to_id), to_port);
+  // a single input drops the link it was connected through before
+  const auto& input = std::as_const(*node_map.at(to_id)).input(to_port);
+  auto& table = writable(links);
+  auto [first, last] = table.into.equal_range(std::pair{to_id, to_port});
+  std::vector<link> stale;
+  for (auto it = first; it != last; ++it) {
+    const auto& source = std::as_const(*node_map.at(it->from_id));
+    if (!input.connected_to(source.output(it->from_port))) {
+      stale.push_back(*it);
+    }
+  }
+  for (auto&& l : stale) {
+    table.erase(l);
+  }
+  table.insert({from_id, from_port, to_id, to_port});
+}
+
+void builder::disconnect(int from_id, int from_port, int to_id, int to_port,
+                         graph& g) {
+  g.disconnect(*node_map.at(from_id), from_port, *node_map.at(to_id),
+               to_port);
+  writable(links).erase({from_id, from_port, to_id, to_port});
+}
+
+void builder::reconfigure(int id, const nlohmann::json& data, graph& g) {
+  const auto& old_node = *node_map.at(id);
+  auto replacement = registry::create(configs->at(id).type, data);
+  auto [into_first, into_last] = links->into.equal_range(id);
+  for (auto it = into_first; it != into_last; ++it) {
+    replacement->input(it->to_port) =
+        std::as_const(*node_map.at(it->from_id)).output(it->from_port);
+  }
+  auto [out_first, out_last] = links->out_of.equal_range(id);
+  for (auto it = out_first; it != out_last; ++it) {
+    auto& input = node_map.at(it->to_id)->input(it->to_port);
+    input.disconnect(old_node.output(it->from_port));
+    input = std::as_const(*replacement).output(it->from_port);
+  }
+  g.replace(node_map.at(id).get(), replacement.get());
+  node_map[id] = std::move(replacement);
+  writable(configs).at(id).data = data;
+}
+}  // namespace dataflow
@@ -0,0 +1,252 @@
+#include "dataflow/executor.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+#include "dataflow/runtime.hpp"
+
+namespace dataflow {
+// Lets handles outlive the executor, see run_handle::cancel
+struct executor::anchor {
+  std::mutex mutex;
+  executor* owner;
+};
+
+struct executor::run_state {
+  plan* p;
+  double stride;
+  std::size_t max_parallel;
+  std::promise<void> promise;
+  bool cancelled = false;
+  std::exception_ptr error;
+
+  // taken from the plan by submit, on the caller's thread
+  std::vector<node*> nodes;
+  std::vector<std::vector<std::size_t>> successors;
+  std::vector<std::size_t> pending;
+  std::vector<std::size_t> ready;
+  std::size_t remaining = 0;
+  std::size_t in_flight = 0;
+  // work received so far, scaled by the inverse of the weight
+  double pass = 0;
+};
+
+executor::run_handle::run_handle(std::shared_ptr<anchor> owner,
+                                 std::shared_ptr<run_state> state,
+                                 std::shared_future<void> future)
+    : owner{std::move(owner)},
+      state{std::move(state)},
+      future{std::move(future)} {}
+
+const std::shared_future<void>& executor::run_handle::completion() const {
+  return future;
+}
+
+void executor::run_handle::wait() const { future.wait(); }
+
+void executor::run_handle::cancel() {
+  // the run has completed if the executor is gone, nothing left to cancel
+  std::lock_guard lock{owner->mutex};
+  if (owner->owner != nullptr) owner->owner->cancel(state);
+}
+
+executor::executor(std::size_t workers)
+    : self{std::make_shared<anchor>()} {
+  self->owner = this;
+  workers = std::max<std::size_t>(workers, 1);
+  threads.reserve(workers);
+  for (std::size_t i = 0; i < workers; ++i) {
+    threads.emplace_back([this] { work(); });
+  }
+}
+
+executor::~executor() {
+  {
+    std::lock_guard lock{self->mutex};
+    self->owner = nullptr;
+  }
+  {
+    std::lock_guard lock{mutex};
+    stopping = true;
+  }
+  changed.notify_all();
+  for (auto& t : threads) {
+    t.join();
+  }
+  auto error = std::make_exception_ptr(
+      std::runtime_error("Executor was destroyed before the run finished"));
+  for (auto& run : active) {
+    run->promise.set_exception(error);
+  }
+  for (auto& [_, queue] : waiting) {
+    for (auto& run : queue) {
+      run->promise.set_exception(error);
+    }
+  }
+}
+
+executor::run_handle executor::submit(plan& p, run_options options) {
+  if (!(options.weight > 0)) {
+    throw std::runtime_error("Run weight must be positive");
+  }
+  auto run = std::make_shared<run_state>();
+  run->p = &p;
+  run->stride = 1.0 / options.weight;
+  run->max_parallel = options.max_parallel;
+
+  // workers never touch the plan or the graph, so they can be used from this
+  // thread while the run is queued or active
+  run->nodes = p.order();
+  const auto& g = p.get_graph();
+  std::map<node*, std::size_t> index;
+  for (std::size_t i = 0; i < run->nodes.size(); ++i) {
+    index[run->nodes[i]] = i;
+  }
+  run->successors.resize(run->nodes.size());
+  run->pending.resize(run->nodes.size());
+  for (std::size_t i = 0; i < run->nodes.size(); ++i) {
+    run->pending[i] = g.adjacency().at(run->nodes[i]).size();
+    for (auto* s : g.successors(run->nodes[i])) {
+      run->successors[i].push_back(index.at(s));
+    }
+  }
+  run->remaining = run->nodes.size();
+
+  std::shared_future<void> future = run->promise.get_future().share();
+  {
+    std::lock_guard lock{mutex};
+    auto busy = std::any_of(active.begin(), active.end(),
+                            [&p](auto& r) { return r->p == &p; });
+    if (busy) {
+      waiting[&p].push_back(run);
+    } else {
+      activate(run);
+    }
+  }
+  changed.notify_all();
+  return {self, run, future};
+}
+
+void executor::drain(const plan& p) {
+  std::unique_lock lock{mutex};
+  changed.wait(lock, [this, &p] {
+    return waiting.count(const_cast<plan*>(&p)) == 0 &&
+           std::none_of(active.begin(), active.end(),
+                        [&p](auto& r) { return r->p == &p; });
+  });
+}
+
+void executor::activate(const std::shared_ptr<run_state>& run) {
+  if (run->cancelled) {
+    finish(run);
+    return;
+  }
+  for (std::size_t i = 0; i < run->nodes.size(); ++i) {
+    if (run->pending[i] == 0) run->ready.push_back(i);
+  }
+
+  // start level with the least served run so newcomers cannot monopolise
+  // the workers either
+  run->pass = 0;
+  if (!active.empty()) {
+    run->pass = (*std::min_element(active.begin(), active.end(),
+                                   [](auto& a, auto& b) {
+                                     return a->pass < b->pass;
+                                   }))
+                    ->pass;
+  }
+  active.push_back(run);
+  if (run->remaining == 0) finish(run);
+}
+
+void executor::finish(const std::shared_ptr<run_state>& run) {
+  active.erase(std::remove(active.begin(), active.end(), run), active.end());
+  if (run->error) {
+    run->promise.set_exception(run->error);
+  } else if (run->cancelled) {
+    run->promise.set_exception(
+        std::make_exception_ptr(std::runtime_error("Run was cancelled")));
+  } else {
+    run->promise.set_value();
+  }
+
+  auto it = waiting.find(run->p);
+  if (it != waiting.end()) {
+    auto next = it->second.front();
+    it->second.pop_front();
+    if (it->second.empty()) waiting.erase(it);
+    activate(next);
+  }
+}
+
+void executor::cancel(const std::shared_ptr<run_state>& run) {
+  {
+    std::lock_guard lock{mutex};
+    run->cancelled = true;
+    auto queued = waiting.find(run->p);
+    if (queued != waiting.end()) {
+      auto& queue = queued->second;
+      if (std::find(queue.begin(), queue.end(), run) != queue.end()) {
+        queue.erase(std::remove(queue.begin(), queue.end(), run), queue.end());
+        if (queue.empty()) waiting.erase(queued);
+        run->promise.set_exception(
+            std::make_exception_ptr(std::runtime_error("Run was cancelled")));
+      }
+    }
+    if (std::find(active.begin(), active.end(), run) != active.end() &&
+        run->in_flight == 0) {
+      finish(run);
+    }
+  }
+  changed.notify_all();
+}
+
+void executor::work() {
+  std::unique_lock lock{mutex};
+  for (;;) {
+    std::shared_ptr<run_state> run;
+    changed.wait(lock, [this, &run] {
+      if (stopping) return true;
+      for (auto& r : active) {
+        if (r->cancelled || r->error || r->ready.empty()) continue;
+        if (r->max_parallel != 0 && r->in_flight >= r->max_parallel) continue;
+        if (!run || r->pass < run->pass) run = r;
+      }
+      return run != nullptr;
+    });
+    if (stopping) return;
+
+    auto i = run->ready.back();
+    run->ready.pop_back();
+    ++run->in_flight;
+    run->pass += run->stride;
+    auto* n = run->nodes[i];
+
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+      impl::invoke(*n);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+
+    --run->in_flight;
+    --run->remaining;
+    if (error) {
+      if (!run->error) run->error = error;
+    } else {
+      for (auto s : run->successors[i]) {
+        if (--run->pending[s] == 0) run->ready.push_back(s);
+      }
+    }
+    bool stopped = run->cancelled || run->error;
+    if (run->remaining == 0 || (stopped && run->in_flight == 0)) {
+      finish(run);
+    }
+    changed.notify_all();
+  }
+}
+}  // namespace dataflow
@@ -1,5 +1,11 @@
 #include "dataflow/graph.hpp"
 
+#include <algorithm>
+#include <functional>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
 namespace dataflow {
 graph::graph(const std::vector<node*>& nodes) {
   for (auto* n : nodes) {
@@ -10,15 +16,146 @@ graph::graph(const std::vector<node*>& nodes) {
       }
     }
   }
+  sort();
 }
 
 graph::graph(std::initializer_list<node*> nodes)
-    : graph({std::begin(nodes), std::end(nodes)}) {}
+    : graph(std::vector<node*>{std::begin(nodes), std::end(nodes)}) {}
+
+graph::graph(std::map<node*, std::set<node*>> adjacency)
+    : adj_list{std::move(adjacency)} {
+  sort();
+}
 
 const std::map<node*, std::set<node*>>& graph::adjacency() const {
   return adj_list;
 }
 
+const std::set<node*>& graph::successors(node* n) const {
+  return succ_list.at(n);
+}
+
+std::vector<node*> graph::order() const {
+  std::vector<node*> result;
+  result.reserve(ranked.size());
+  for (auto&& [_, n] : ranked) {
+    result.push_back(n);
+  }
+  return result;
+}
+
+std::uint64_t graph::revision() const { return revision_count; }
+
+std::optional<std::vector<node*>> graph::changed_since(
+    std::uint64_t r) const {
+  if (r < forgotten) return std::nullopt;
+  std::set<node*> result;
+  for (auto it = change_log.rbegin();
+       it != change_log.rend() && it->first > r; ++it) {
+    if (adj_list.count(it->second) != 0) result.insert(it->second);
+  }
+  return std::vector<node*>{result.begin(), result.end()};
+}
+
+void graph::insert(node* n) {
+  if (adj_list.count(n) != 0) return;
+  append(n);
+  try {
+    for (auto&& [m, _] : adj_list) {
+      if (m == n) continue;
+      if (n->input_connected_to(*m)) add_edge(m, n);
+      if (m->input_connected_to(*n)) add_edge(n, m);
+    }
+  } catch (...) {
+    detach(n);
+    throw;
+  }
+}
+
+void graph::insert(node* n, const std::set<node*>& dependencies) {
+  if (adj_list.count(n) != 0) return;
+  for (auto* m : dependencies) {
+    require(m);
+  }
+  // ranked after every other node, so none of the edges can reorder
+  append(n);
+  for (auto* m : dependencies) {
+    add_edge(m, n);
+  }
+}
+
+void graph::erase(node* n) {
+  require(n);
+  for (auto* s : succ_list.at(n)) {
+    for (std::size_t j = 0; j < s->input_size(); ++j) {
+      for (std::size_t i = 0; i < n->output_size(); ++i) {
+        s->input(j).disconnect(std::as_const(*n).output(i));
+      }
+    }
+  }
+  detach(n);
+}
+
+void graph::connect(node& from, std::size_t output, node& to,
+                    std::size_t input) {
+  require(&from);
+  require(&to);
+  // the cycle check comes first so a rejected connection leaves the port as
+  // it was, including a previous source of a single input
+  bool existed = adj_list.at(&to).count(&from) != 0;
+  add_edge(&from, &to);
+  try {
+    to.input(input) = std::as_const(from).output(output);
+  } catch (...) {
+    if (!existed) remove_edge(&from, &to);
+    throw;
+  }
+  // a single input may have been taken over from another node
+  std::vector<node*> stale;
+  for (auto* m : adj_list.at(&to)) {
+    if (!to.input_connected_to(*m)) stale.push_back(m);
+  }
+  for (auto* m : stale) {
+    remove_edge(m, &to);
+  }
+}
+
+void graph::disconnect(node& from, std::size_t output, node& to,
+                       std::size_t input) {
+  require(&from);
+  require(&to);
+  to.input(input).disconnect(std::as_const(from).output(output));
+  if (!to.input_connected_to(from)) remove_edge(&from, &to);
+}
+
+void graph::replace(node* old_node, node* new_node) {
+  require(old_node);
+  auto deps = std::move(adj_list.at(old_node));
+  auto succs = std::move(succ_list.at(old_node));
+  for (auto* m : deps) {
+    succ_list.at(m).erase(old_node);
+    succ_list.at(m).insert(new_node);
+  }
+  for (auto* m : succs) {
+    adj_list.at(m).erase(old_node);
+    adj_list.at(m).insert(new_node);
+  }
+  adj_list.erase(old_node);
+  succ_list.erase(old_node);
+  adj_list[new_node] = std::move(deps);
+  succ_list[new_node] = std::move(succs);
+
+  auto r = rank.at(old_node);
+  rank.erase(old_node);
+  rank[new_node] = r;
+  ranked[r] = new_node;
+  ++revision_count;
+  note(new_node);
+  for (auto* m : succ_list.at(new_node)) {
+    note(m);
+  }
+}
+
 void graph::dump(std::ostream& out) const {
   std::map<node*, int> node_ids;
   int counter = 0;
@@ -38,4 +175,147 @@ void graph::dump(std::ostream& out) const {
   }
   out << "}" << '\n';
 }
+
+void graph::sort() {
+  for (auto&& [n, deps] : adj_list) {
+    succ_list[n];
+    for (auto* m : deps) {
+      succ_list[m].insert(n);
+    }
+  }
+
+  // topological sort
+  std::map<node*, bool> visited;
+  std::uint64_t counter = 0;
+
+  std::function<void(node*)> topo_sort = [this, &visited, &counter,
+                                          &topo_sort](node* n) {
+    if (visited[n]) return;
+
+    visited[n] = true;
+
+    auto& deps = adj_list.at(n);
+    for (auto m : deps) {
+      if (!visited[m]) {
+        topo_sort(m);
+      }
+    }
+
+    rank[n] = counter;
+    ranked[counter++] = n;
+  };
+
+  for (auto&& [n, deps] : adj_list) {
+    topo_sort(n);
+  }
+}
+
+// Pearce-Kelly: only the nodes ranked between the two ends of the new edge
+// that are reachable from them have to move
+void graph::add_edge(node* from, node* to) {
+  if (from == to) {
+    throw std::runtime_error("Connection would create a cycle");
+  }
+  if (!adj_list.at(to).insert(from).second) return;
+  succ_list.at(from).insert(to);
+  ++revision_count;
+  note(to);
+
+  auto lower = rank.at(to);
+  auto upper = rank.at(from);
+  if (upper < lower) return;
+
+  std::vector<node*> forward;
+  std::set<node*> seen{to};
+  std::vector<node*> stack{to};
+  while (!stack.empty()) {
+    auto* n = stack.back();
+    stack.pop_back();
+    forward.push_back(n);
+    for (auto* s : succ_list.at(n)) {
+      if (s == from) {
+        remove_edge(from, to);
+        throw std::runtime_error("Connection would create a cycle");
+      }
+      if (rank.at(s) < upper && seen.insert(s).second) stack.push_back(s);
+    }
+  }
+
+  std::vector<node*> backward;
+  stack = {from};
+  seen = {from};
+  while (!stack.empty()) {
+    auto* n = stack.back();
+    stack.pop_back();
+    backward.push_back(n);
+    for (auto* p : adj_list.at(n)) {
+      if (rank.at(p) > lower && seen.insert(p).second) stack.push_back(p);
+    }
+  }
+
+  auto by_rank = [this](node* a, node* b) { return rank.at(a) < rank.at(b); };
+  std::sort(forward.begin(), forward.end(), by_rank);
+  std::sort(backward.begin(), backward.end(), by_rank);
+
+  std::vector<std::uint64_t> slots;
+  for (auto* n : backward) slots.push_back(rank.at(n));
+  for (auto* n : forward) slots.push_back(rank.at(n));
+  std::sort(slots.begin(), slots.end());
+
+  std::size_t i = 0;
+  for (auto* n : backward) {
+    rank[n] = slots[i];
+    ranked[slots[i++]] = n;
+  }
+  for (auto* n : forward) {
+    rank[n] = slots[i];
+    ranked[slots[i++]] = n;
+  }
+}
+
+void graph::remove_edge(node* from, node* to) {
+  adj_list.at(to).erase(from);
+  succ_list.at(from).erase(to);
+  ++revision_count;
+  note(to);
+}
+
+void graph::append(node* n) {
+  adj_list[n];
+  succ_list[n];
+  auto r = ranked.empty() ? 0 : ranked.rbegin()->first + 1;
+  rank[n] = r;
+  ranked[r] = n;
+  ++revision_count;
+  note(n);
+}
+
+void graph::detach(node* n) {
+  ++revision_count;
+  for (auto* m : adj_list.at(n)) {
+    succ_list.at(m).erase(n);
+  }
+  for (auto* m : succ_list.at(n)) {
+    adj_list.at(m).erase(n);
+    note(m);
+  }
+  adj_list.erase(n);
+  succ_list.erase(n);
+  ranked.erase(rank.at(n));
+  rank.erase(n);
+}
+
+void graph::note(node* n) {
+  change_log.emplace_back(revision_count, n);
+  if (change_log.size() > max_logged_changes) {
+    forgotten = change_log.front().first;
+    change_log.pop_front();
+  }
+}
+
+void graph::require(node* n) const {
+  if (adj_list.count(n) == 0) {
+    throw std::runtime_error("Node " + n->label() + " is not part of the graph");
+  }
+}
 }  // namespace dataflow
@@ -38,8 +38,30 @@ bool node::input_connected_to(const node& other) const {
   return other.output_connected_to(*this);
 }
 
+void node::publish() {
+  for (auto&& p : output_ports) {
+    p->publish();
+  }
+}
+
+void node::relocate() {
+  for (auto&& p : output_ports) {
+    p->relocate();
+  }
+}
+
 void node::set_label(const std::string& label) { node_label = label; }
 
+void node::copy_labels(const node& original) {
+  node_label = original.node_label;
+  for (std::size_t i = 0; i < input_ports.size(); ++i) {
+    input_ports[i]->label = original.input_name(i);
+  }
+  for (std::size_t i = 0; i < output_ports.size(); ++i) {
+    output_ports[i]->label = original.output_name(i);
+  }
+}
+
 void node::set_input_label(std::size_t i, const std::string& label) {
   input_ports.at(i)->label = label;
 }
@@ -0,0 +1,155 @@
+#include "dataflow/partition.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace dataflow {
+namespace {
+double cost_of(const std::map<node*, double>& cost, node* n) {
+  auto it = cost.find(n);
+  return it == cost.end() ? 1.0 : it->second;
+}
+
+// Parses the kernel's cpulist format, e.g. "0-3,8-11"
+std::vector<int> parse_cpulist(const std::string& list) {
+  std::vector<int> cpus;
+  std::stringstream stream{list};
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    if (range.empty()) continue;
+    auto dash = range.find('-');
+    int first = std::stoi(range.substr(0, dash));
+    int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+}  // namespace
+
+std::map<node*, double> measure_cost(plan& p, std::size_t runs) {
+  using clock = std::chrono::steady_clock;
+  std::map<node*, double> result;
+  for (std::size_t i = 0; i < runs; ++i) {
+    for (auto* n : p.order()) {
+      auto start = clock::now();
+      (*n)();
+      n->publish();
+      result[n] += std::chrono::duration<double>(clock::now() - start).count();
+    }
+  }
+  for (auto&& [_, seconds] : result) {
+    seconds /= static_cast<double>(runs);
+  }
+  return result;
+}
+
+partitioning partition(const plan& p, std::size_t count,
+                       const std::map<node*, double>& cost) {
+  if (count == 0) {
+    throw std::runtime_error("Cannot split a graph into zero partitions");
+  }
+  const auto& adj = p.get_graph().adjacency();
+  const auto& order = p.order();
+
+  std::map<node*, std::vector<node*>> successors;
+  double total = 0;
+  double heaviest = 0;
+  for (auto* n : order) {
+    for (auto* m : adj.at(n)) {
+      successors[m].push_back(n);
+    }
+    total += cost_of(cost, n);
+    heaviest = std::max(heaviest, cost_of(cost, n));
+  }
+  // allow some imbalance in exchange for fewer cut edges
+  const double capacity =
+      std::max(heaviest, 1.1 * total / static_cast<double>(count));
+
+  partitioning result;
+  result.revision = p.get_graph().revision();
+  std::vector<double> load(count, 0.0);
+
+  // greedy growing in execution order: follow the dependencies into the
+  // partition that already holds most of them as long as it has room
+  for (auto* n : order) {
+    std::vector<std::size_t> affinity(count, 0);
+    for (auto* m : adj.at(n)) {
+      ++affinity[result.owner.at(m)];
+    }
+    std::size_t best = count;
+    for (std::size_t k = 0; k < count; ++k) {
+      if (load[k] + cost_of(cost, n) > capacity) continue;
+      if (best == count || affinity[k] > affinity[best] ||
+          (affinity[k] == affinity[best] && load[k] < load[best])) {
+        best = k;
+      }
+    }
+    if (best == count) {
+      best = static_cast<std::size_t>(
+          std::min_element(load.begin(), load.end()) - load.begin());
+    }
+    result.owner[n] = best;
+    load[best] += cost_of(cost, n);
+  }
+
+  // one refinement sweep moving nodes next to most of their neighbours
+  for (auto* n : order) {
+    std::vector<std::size_t> neighbours(count, 0);
+    for (auto* m : adj.at(n)) ++neighbours[result.owner.at(m)];
+    for (auto* m : successors[n]) ++neighbours[result.owner.at(m)];
+    auto current = result.owner.at(n);
+    auto target = static_cast<std::size_t>(
+        std::max_element(neighbours.begin(), neighbours.end()) -
+        neighbours.begin());
+    if (neighbours[target] > neighbours[current] &&
+        load[target] + cost_of(cost, n) <= capacity) {
+      load[current] -= cost_of(cost, n);
+      load[target] += cost_of(cost, n);
+      result.owner[n] = target;
+    }
+  }
+
+  result.parts.resize(count);
+  for (auto* n : order) {
+    result.parts[result.owner.at(n)].push_back(n);
+    for (auto* m : adj.at(n)) {
+      if (result.owner.at(m) != result.owner.at(n)) ++result.cut_edges;
+    }
+  }
+  return result;
+}
+
+std::vector<int> numa_ordered_cpus() {
+  std::vector<int> cpus;
+  std::set<int> seen;
+  std::string content;
+  if (std::ifstream online{"/sys/devices/system/node/online"}) {
+    std::getline(online, content);
+  }
+  // node ids share the cpulist format
+  for (int numa_node : parse_cpulist(content)) {
+    std::ifstream list{"/sys/devices/system/node/node" +
+                       std::to_string(numa_node) + "/cpulist"};
+    std::string node_cpus;
+    std::getline(list, node_cpus);
+    for (int cpu : parse_cpulist(node_cpus)) {
+      if (seen.insert(cpu).second) cpus.push_back(cpu);
+    }
+  }
+  if (cpus.empty()) {
+    auto hardware = std::max(1U, std::thread::hardware_concurrency());
+    for (unsigned cpu = 0; cpu < hardware; ++cpu) {
+      cpus.push_back(static_cast<int>(cpu));
+    }
+  }
+  return cpus;
+}
+}  // namespace dataflow
@@ -0,0 +1,151 @@
+#include "dataflow/plan.hpp"
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace dataflow {
+namespace {
+std::string describe(const node& n) {
+  return n.label().empty() ? "unnamed node" : "node " + n.label();
+}
+
+std::string describe_input(const node& n, std::size_t i) {
+  auto result = "input " + std::to_string(i);
+  if (!n.input_name(i).empty()) result += " (" + n.input_name(i) + ")";
+  return result + " of " + describe(n);
+}
+
+std::string join(const std::vector<std::string>& problems) {
+  std::string message = "Graph cannot be run:";
+  for (auto&& p : problems) {
+    message += "\n  " + p;
+  }
+  return message;
+}
+
+void check_inputs(const graph& g, node* n, std::vector<std::string>& problems) {
+  const auto& deps = g.adjacency().at(n);
+  for (std::size_t i = 0; i < n->input_size(); ++i) {
+    const auto& input = std::as_const(*n).input(i);
+    if (input.empty()) {
+      if (input.required()) {
+        problems.push_back(describe_input(*n, i) + " is not connected");
+      }
+      continue;
+    }
+    // a multi port can read from several nodes, every one has to be in g
+    std::size_t found = 0;
+    for (auto* m : deps) {
+      for (std::size_t j = 0; j < m->output_size(); ++j) {
+        if (std::as_const(*m).output(j).connected_to(input)) ++found;
+      }
+    }
+    if (found < input.connections()) {
+      problems.push_back(describe_input(*n, i) +
+                         " is connected to a node outside of the graph");
+    }
+  }
+}
+}  // namespace
+
+validation_error::validation_error(std::vector<std::string> problems)
+    : std::runtime_error(join(problems)), problem_list{std::move(problems)} {}
+
+const std::vector<std::string>& validation_error::problems() const {
+  return problem_list;
+}
+
+std::vector<std::string> validate(const graph& g) {
+  std::vector<std::string> problems;
+  const auto& adj = g.adjacency();
+
+  for (auto&& [n, _] : adj) {
+    check_inputs(g, n, problems);
+  }
+
+  std::map<node*, std::size_t> position;
+  for (auto* n : g.order()) {
+    position.emplace(n, position.size());
+  }
+  for (auto&& [n, deps] : adj) {
+    for (auto* m : deps) {
+      if (adj.count(m) != 0 && position.at(m) >= position.at(n)) {
+        problems.push_back(describe(*m) + " and " + describe(*n) +
+                           " are part of a cycle");
+      }
+    }
+  }
+  return problems;
+}
+
+plan::plan(graph& g) : g{&g}, revision{g.revision()}, sorted{g.order()} {
+  if (auto problems = validate(g); !problems.empty()) {
+    throw validation_error(std::move(problems));
+  }
+}
+
+graph& plan::get_graph() const { return *g; }
+
+const std::vector<node*>& plan::order() const {
+  refresh();
+  return sorted;
+}
+
+const std::vector<node*>& plan::cone(std::vector<node*> targets) {
+  refresh();
+  std::sort(targets.begin(), targets.end());
+  targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+  if (auto it = cones.find(targets); it != cones.end()) {
+    return it->second;
+  }
+
+  // walk the dependencies backwards from the targets
+  const auto& adj = g->adjacency();
+  std::set<node*> required;
+  std::vector<node*> stack;
+  for (auto* t : targets) {
+    if (adj.find(t) == adj.end()) {
+      throw std::runtime_error("Target node " + t->label() +
+                               " is not part of the graph");
+    }
+    if (required.insert(t).second) stack.push_back(t);
+  }
+  while (!stack.empty()) {
+    auto* n = stack.back();
+    stack.pop_back();
+    for (auto* m : adj.at(n)) {
+      if (required.insert(m).second) stack.push_back(m);
+    }
+  }
+
+  std::vector<node*> result;
+  result.reserve(required.size());
+  for (auto* n : sorted) {
+    if (required.count(n) != 0) result.push_back(n);
+  }
+  return cones.emplace(std::move(targets), std::move(result)).first->second;
+}
+
+void plan::refresh() const {
+  if (revision == g->revision()) return;
+  // edits cannot create cycles, so only the inputs of the nodes they touched
+  // have to be checked again
+  std::vector<std::string> problems;
+  if (auto changed = g->changed_since(revision)) {
+    for (auto* n : *changed) {
+      check_inputs(*g, n, problems);
+    }
+  } else {
+    problems = validate(*g);
+  }
+  if (!problems.empty()) {
+    throw validation_error(std::move(problems));
+  }
+  revision = g->revision();
+  sorted = g->order();
+  cones.clear();
+}
+}  // namespace dataflow
@@ -0,0 +1,58 @@
+#include "dataflow/pool.hpp"
+
+#include <utility>
+
+namespace dataflow {
+instance_pool::instance::instance(std::unique_ptr<builder> b)
+    : nodes{std::move(b)}, g{nodes->adjacency()}, p{g} {}
+
+instance_pool::lease::lease(lease&& other) noexcept
+    : owner{std::exchange(other.owner, nullptr)},
+      inst{std::exchange(other.inst, nullptr)} {}
+
+instance_pool::lease& instance_pool::lease::operator=(lease&& other) noexcept {
+  if (this != &other) {
+    if (owner != nullptr) owner->release(inst);
+    owner = std::exchange(other.owner, nullptr);
+    inst = std::exchange(other.inst, nullptr);
+  }
+  return *this;
+}
+
+instance_pool::lease::~lease() {
+  if (owner != nullptr) owner->release(inst);
+}
+
+builder& instance_pool::lease::nodes() const { return *inst->nodes; }
+
+graph& instance_pool::lease::get_graph() const { return inst->g; }
+
+plan& instance_pool::lease::get_plan() const { return inst->p; }
+
+instance_pool::instance_pool(const builder& prototype, std::size_t size) {
+  instances.reserve(size);
+  idle.reserve(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    instances.push_back(std::make_unique<instance>(prototype.clone()));
+    idle.push_back(instances.back().get());
+  }
+}
+
+instance_pool::lease instance_pool::acquire() {
+  std::unique_lock lock{mutex};
+  available.wait(lock, [this] { return !idle.empty(); });
+  auto* inst = idle.back();
+  idle.pop_back();
+  return {this, inst};
+}
+
+std::size_t instance_pool::size() const { return instances.size(); }
+
+void instance_pool::release(instance* inst) {
+  {
+    std::lock_guard lock{mutex};
+    idle.push_back(inst);
+  }
+  available.notify_one();
+}
+}  // namespace dataflow
@@ -0,0 +1,453 @@
+#include "dataflow/process.hpp"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <new>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "dataflow/runtime.hpp"
+
+namespace dataflow {
+namespace {
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free &&
+                  std::atomic<int>::is_always_lock_free,
+              "Shared memory ports need lock-free atomics");
+
+constexpr std::size_t ring_depth = 2;
+constexpr std::size_t alignment = 64;
+constexpr std::uint64_t stop_epoch = ~std::uint64_t{0};
+
+enum status : int { starting, ready, failed };
+
+struct control_block {
+  std::atomic<std::uint64_t> requested{0};
+  std::atomic<std::uint64_t> completed{0};
+  std::atomic<int> state{starting};
+  char message[256]{};
+};
+
+struct channel_header {
+  std::atomic<std::uint64_t> written{0};
+  std::atomic<std::uint64_t> read{0};
+};
+
+std::size_t align_up(std::size_t n) {
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+// Waits for ready() to become true, calling alive() every now and then to
+// bail out if the other side went away
+template <typename Ready>
+void wait_until(Ready&& is_ready, const std::function<void()>& alive) {
+  for (unsigned spins = 0; !is_ready(); ++spins) {
+    if (spins < 1024) {
+      std::this_thread::yield();
+    } else {
+      alive();
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+}
+
+void set_message(control_block& control, const std::string& message) {
+  auto n = std::min(message.size(), sizeof(control.message) - 1);
+  std::memcpy(control.message, message.data(), n);
+  control.message[n] = '\0';
+}
+}  // namespace
+
+struct process_group::state {
+  // An output port read by nodes of another process
+  struct channel {
+    int from_id;
+    int from_port;
+    std::size_t to_process;
+    std::vector<std::pair<int, int>> targets;
+    std::size_t offset;
+  };
+
+  // Nodes of one process together with the ends of their channels
+  class endpoint {
+   public:
+    endpoint(state& s, std::size_t process) : shared{s} {
+      nlohmann::json config{{"nodes", nlohmann::json::array()},
+                            {"links", nlohmann::json::array()}};
+      for (auto&& n : s.config["nodes"]) {
+        if (s.owner.at(n["id"]) == process) config["nodes"].push_back(n);
+      }
+      for (auto&& l : s.config["links"]) {
+        if (s.owner.at(l["from"]["id"]) == process &&
+            s.owner.at(l["to"]["id"]) == process) {
+          config["links"].push_back(l);
+        }
+      }
+      nodes = std::make_unique<builder>(config.dump());
+
+      std::map<int, std::vector<std::size_t>> receives;
+      std::map<int, std::vector<std::size_t>> sends;
+      std::set<std::size_t> scheduled;
+      for (std::size_t c = 0; c < s.channels.size(); ++c) {
+        auto& ch = s.channels[c];
+        if (ch.to_process == process) {
+          auto& first = nodes->get(ch.targets.front().first);
+          proxies[c] = first.input(ch.targets.front().second).make_source();
+          for (auto&& [to_id, to_port] : ch.targets) {
+            nodes->get(to_id).input(to_port) = *proxies[c];
+          }
+        } else if (s.owner.at(ch.from_id) == process) {
+          sends[ch.from_id].push_back(c);
+        }
+      }
+      for (int id : s.order) {
+        if (s.owner.at(id) != process) continue;
+        // nodes read their inputs unchecked, see dataflow::validate
+        const auto& n = std::as_const(nodes->get(id));
+        for (std::size_t i = 0; i < n.input_size(); ++i) {
+          if (n.input(i).required() && n.input(i).empty()) {
+            throw std::runtime_error("Input " + std::to_string(i) +
+                                     " of node " + std::to_string(id) +
+                                     " is not connected");
+          }
+        }
+        step st{&nodes->get(id), {}, std::move(sends[id])};
+        // receive every channel before the first local node that reads it
+        for (auto&& [c, _] : proxies) {
+          for (auto&& [to_id, to_port] : s.channels[c].targets) {
+            if (to_id == id && scheduled.insert(c).second) {
+              st.receives.push_back(c);
+            }
+          }
+        }
+        steps.push_back(std::move(st));
+      }
+    }
+
+    void run(const std::function<void()>& alive) {
+      for (auto& st : steps) {
+        for (auto c : st.receives) receive(c, alive);
+        impl::invoke(*st.n);
+        for (auto c : st.sends) send(c, alive);
+      }
+    }
+
+    std::unique_ptr<builder> nodes;
+
+   private:
+    struct step {
+      node* n;
+      std::vector<std::size_t> receives;
+      std::vector<std::size_t> sends;
+    };
+
+    char* slot(const channel& ch, std::uint64_t seq) const {
+      return shared.memory + ch.offset + align_up(sizeof(channel_header)) +
+             (seq % ring_depth) * shared.slot_stride();
+    }
+
+    void send(std::size_t c, const std::function<void()>& alive) {
+      auto& ch = shared.channels[c];
+      auto* header = shared.header(ch);
+      buffer.clear();
+      std::as_const(nodes->get(ch.from_id)).output(ch.from_port).save(buffer);
+      if (buffer.size() > shared.slot_size) {
+        throw std::runtime_error(
+            "Output " + std::to_string(ch.from_port) + " of node " +
+            std::to_string(ch.from_id) + " does not fit in a shared slot");
+      }
+      auto seq = header->written.load();
+      wait_until([&] { return seq - header->read.load() < ring_depth; },
+                 alive);
+      auto* dst = slot(ch, seq);
+      std::uint64_t size = buffer.size();
+      std::memcpy(dst, &size, sizeof(size));
+      std::memcpy(dst + sizeof(size), buffer.data(), buffer.size());
+      header->written.store(seq + 1);
+    }
+
+    void receive(std::size_t c, const std::function<void()>& alive) {
+      auto& ch = shared.channels[c];
+      auto* header = shared.header(ch);
+      auto seq = header->read.load();
+      wait_until([&] { return header->written.load() > seq; }, alive);
+      const auto* src = slot(ch, seq);
+      std::uint64_t size = 0;
+      std::memcpy(&size, src, sizeof(size));
+      proxies[c]->load({src + sizeof(size), static_cast<std::size_t>(size)});
+      header->read.store(seq + 1);
+    }
+
+    state& shared;
+    std::map<std::size_t, std::unique_ptr<port>> proxies;
+    std::vector<step> steps;
+    std::string buffer;
+  };
+
+  state(const std::string& config_json, std::size_t slot_bytes)
+      : config(nlohmann::json::parse(config_json)), slot_size{slot_bytes} {
+    for (auto&& n : config["nodes"]) {
+      std::size_t process = n.value("process", 0);
+      owner[n["id"]] = process;
+      processes = std::max(processes, process + 1);
+    }
+    sort_nodes();
+
+    std::map<std::tuple<int, int, std::size_t>, std::size_t> channel_ids;
+    for (auto&& l : config["links"]) {
+      int from_id = l["from"]["id"];
+      int from_port = l["from"]["port"];
+      int to_id = l["to"]["id"];
+      int to_port = l["to"]["port"];
+      auto to_process = owner.at(to_id);
+      if (owner.at(from_id) == to_process) continue;
+      auto key = std::make_tuple(from_id, from_port, to_process);
+      auto it = channel_ids.find(key);
+      if (it == channel_ids.end()) {
+        it = channel_ids.emplace(key, channels.size()).first;
+        channels.push_back({from_id, from_port, to_process, {}, 0});
+      }
+      channels[it->second].targets.emplace_back(to_id, to_port);
+    }
+
+    map_memory();
+    try {
+      // Every endpoint is built before forking. A worker only runs its
+      // prebuilt steps, it does not parse the config or create nodes while a
+      // lock held by another thread of this process may have been copied.
+      std::vector<std::unique_ptr<endpoint>> endpoints;
+      for (std::size_t p = 0; p < processes; ++p) {
+        endpoints.push_back(std::make_unique<endpoint>(*this, p));
+      }
+      for (std::size_t p = 1; p < processes; ++p) {
+        pid_t pid = fork();
+        if (pid < 0) throw std::runtime_error("Could not fork worker process");
+        if (pid == 0) worker_main(p, *endpoints[p]);
+        workers.push_back(pid);
+      }
+      local = std::move(endpoints.front());
+      endpoints.clear();
+
+      for (std::size_t p = 1; p < processes; ++p) {
+        auto& c = control(p);
+        wait_until([&c] { return c.state.load() != starting; },
+                   [this] { check_workers(); });
+      }
+      check_workers();
+    } catch (...) {
+      broken = true;
+      shutdown();
+      throw;
+    }
+  }
+
+  ~state() { shutdown(); }
+
+  state(const state&) = delete;
+  state& operator=(const state&) = delete;
+
+  void run() {
+    if (broken) {
+      throw std::runtime_error("Process group is no longer usable");
+    }
+    ++epoch;
+    for (std::size_t p = 1; p < processes; ++p) {
+      control(p).requested.store(epoch);
+    }
+    try {
+      local->run([this] { check_workers(); });
+      for (std::size_t p = 1; p < processes; ++p) {
+        auto& c = control(p);
+        wait_until(
+            [&c, this] {
+              return c.completed.load() == epoch || c.state.load() == failed;
+            },
+            [this] { check_workers(); });
+      }
+      check_workers();
+    } catch (...) {
+      broken = true;
+      throw;
+    }
+  }
+
+  [[nodiscard]] control_block& control(std::size_t p) const {
+    return *reinterpret_cast<control_block*>(
+        memory + p * align_up(sizeof(control_block)));
+  }
+
+  [[nodiscard]] channel_header* header(const channel& ch) const {
+    return reinterpret_cast<channel_header*>(memory + ch.offset);
+  }
+
+  [[nodiscard]] std::size_t slot_stride() const {
+    return align_up(sizeof(std::uint64_t) + slot_size);
+  }
+
+  nlohmann::json config;
+  std::size_t slot_size;
+  std::size_t processes = 1;
+  std::map<int, std::size_t> owner;
+  // global execution order of node ids
+  std::vector<int> order;
+  std::vector<channel> channels;
+
+  char* memory = nullptr;
+  std::size_t memory_size = 0;
+  std::vector<pid_t> workers;
+  std::uint64_t epoch = 0;
+  bool broken = false;
+  std::unique_ptr<endpoint> local;
+
+ private:
+  void sort_nodes() {
+    std::map<int, std::size_t> pending;
+    std::map<int, std::vector<int>> successors;
+    for (auto&& [id, _] : owner) pending[id] = 0;
+    for (auto&& l : config["links"]) {
+      ++pending.at(l["to"]["id"]);
+      successors[l["from"]["id"]].push_back(l["to"]["id"]);
+    }
+    std::vector<int> ready_ids;
+    for (auto&& [id, count] : pending) {
+      if (count == 0) ready_ids.push_back(id);
+    }
+    while (!ready_ids.empty()) {
+      int id = ready_ids.back();
+      ready_ids.pop_back();
+      order.push_back(id);
+      for (int next : successors[id]) {
+        if (--pending.at(next) == 0) ready_ids.push_back(next);
+      }
+    }
+    if (order.size() != owner.size()) {
+      throw std::runtime_error("Graph contains a cycle");
+    }
+  }
+
+  void map_memory() {
+    std::size_t offset = processes * align_up(sizeof(control_block));
+    for (auto& ch : channels) {
+      ch.offset = offset;
+      offset += align_up(sizeof(channel_header)) + ring_depth * slot_stride();
+    }
+    memory_size = offset;
+
+    static std::atomic<unsigned> counter{0};
+    auto name = "/dataflow-" + std::to_string(getpid()) + "-" +
+                std::to_string(counter++);
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) throw std::runtime_error("Could not create shared memory");
+    // every process maps it before forking, so the name is not needed
+    shm_unlink(name.c_str());
+    if (ftruncate(fd, static_cast<off_t>(memory_size)) != 0) {
+      close(fd);
+      throw std::runtime_error("Could not size shared memory");
+    }
+    void* ptr = mmap(nullptr, memory_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+      throw std::runtime_error("Could not map shared memory");
+    }
+    memory = static_cast<char*>(ptr);
+    for (std::size_t p = 0; p < processes; ++p) {
+      new (&control(p)) control_block{};
+    }
+    for (auto& ch : channels) {
+      new (header(ch)) channel_header{};
+    }
+  }
+
+  void shutdown() {
+    if (memory == nullptr) return;
+    for (std::size_t p = 1; p < processes; ++p) {
+      control(p).requested.store(stop_epoch);
+    }
+    for (auto pid : workers) {
+      if (pid <= 0) continue;
+      if (broken) kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+    }
+    workers.clear();
+    munmap(memory, memory_size);
+    memory = nullptr;
+  }
+
+  void check_workers() {
+    for (std::size_t p = 1; p < processes; ++p) {
+      if (control(p).state.load() == failed) {
+        broken = true;
+        throw std::runtime_error("Process " + std::to_string(p) +
+                                 " failed: " + control(p).message);
+      }
+    }
+    for (std::size_t i = 0; i < workers.size(); ++i) {
+      if (workers[i] > 0 && waitpid(workers[i], nullptr, WNOHANG) != 0) {
+        workers[i] = -1;
+        broken = true;
+        throw std::runtime_error("Process " + std::to_string(i + 1) +
+                                 " exited unexpectedly");
+      }
+    }
+  }
+
+  [[noreturn]] void worker_main(std::size_t p, endpoint& self) {
+    // the coordinator's handles belong to the coordinator
+    workers.clear();
+    auto& c = control(p);
+    pid_t parent = getppid();
+    const std::function<void()> alive = [parent] {
+      if (getppid() != parent) _exit(EXIT_FAILURE);
+    };
+    try {
+      c.state.store(ready);
+      std::uint64_t done = 0;
+      for (;;) {
+        wait_until([&c, done] { return c.requested.load() != done; }, alive);
+        done = c.requested.load();
+        if (done == stop_epoch) break;
+        self.run(alive);
+        c.completed.store(done);
+      }
+    } catch (std::exception& e) {
+      set_message(c, e.what());
+      c.state.store(failed);
+    } catch (...) {
+      set_message(c, "unknown exception");
+      c.state.store(failed);
+    }
+    _exit(EXIT_SUCCESS);
+  }
+};
+
+process_group::process_group(const std::string& config_json,
+                             std::size_t slot_size)
+    : shared{std::make_unique<state>(config_json, slot_size)} {}
+
+process_group::~process_group() = default;
+
+void process_group::run() { shared->run(); }
+
+builder& process_group::local() const { return *shared->local->nodes; }
+
+std::size_t process_group::size() const { return shared->processes; }
+}  // namespace dataflow
@@ -1,38 +1,253 @@
 #include "dataflow/runtime.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <exception>
 #include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 namespace dataflow {
-void run_serial(graph& g) {
-  auto adj = g.adjacency();
-  // topological sort
-  std::vector<node*> sorted;
-  std::map<node*, bool> visited;
+namespace {
+void run_nodes(const std::vector<node*>& nodes) {
+  for (auto& n : nodes) {
+    impl::invoke(*n);
+  }
+}
 
-  std::function<void(node*)> topo_sort = [&adj, &visited, &sorted,
-                                          &topo_sort](node* n) {
-    if (visited[n]) return;
+// Called by a worker itself before it runs any node, so that what its nodes
+// allocate while running is placed on the right NUMA node. Port values created
+// earlier are moved by parallel_runner, see port::relocate.
+void pin_this_thread([[maybe_unused]] int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
 
-    visited[n] = true;
+int cpu_for(const std::vector<int>& cpus, std::size_t k) {
+  return cpus.empty() ? -1 : cpus[k % cpus.size()];
+}
 
-    auto& deps = adj.at(n);
-    for (auto m : deps) {
-      if (!visited[m]) {
-        topo_sort(m);
-      }
+// Runs the partitions of parts, launch(task) has to call task(k) once for
+// every partition k and return when all of them have returned
+void run_partitions(
+    plan& p, const partitioning& parts,
+    const std::function<void(const std::function<void(std::size_t)>&)>&
+        launch) {
+  const auto& order = p.order();
+  const auto& adj = p.get_graph().adjacency();
+  if (parts.revision != p.get_graph().revision() ||
+      parts.owner.size() != order.size()) {
+    throw std::runtime_error("Partitioning does not match the plan");
+  }
+
+  std::map<node*, std::size_t> index;
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    index[order[i]] = i;
+  }
+  // dependencies computed by other partitions, per node
+  std::vector<std::vector<std::size_t>> remote(order.size());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    auto owner = parts.owner.at(order[i]);
+    for (auto* m : adj.at(order[i])) {
+      if (parts.owner.at(m) != owner) remote[i].push_back(index.at(m));
     }
+  }
+
+  std::unique_ptr<std::atomic<bool>[]> done{
+      new std::atomic<bool>[order.size()]()};
+  std::atomic<bool> failed{false};
+  std::exception_ptr error;
+  std::mutex error_mutex;
 
-    sorted.push_back(n);
+  std::function<void(std::size_t)> run_part = [&](std::size_t k) {
+    const auto& nodes = parts.parts[k];
+    try {
+      for (auto* n : nodes) {
+        auto i = index.at(n);
+        for (auto dep : remote[i]) {
+          while (!done[dep].load(std::memory_order_acquire)) {
+            if (failed.load(std::memory_order_relaxed)) return;
+            std::this_thread::yield();
+          }
+        }
+        impl::invoke(*n);
+        done[i].store(true, std::memory_order_release);
+      }
+    } catch (...) {
+      std::lock_guard lock{error_mutex};
+      if (!error) error = std::current_exception();
+      failed.store(true);
+    }
   };
 
-  for (auto&& [n, deps] : adj) {
-    topo_sort(n);
+  launch(run_part);
+  if (error) std::rethrow_exception(error);
+}
+}  // namespace
+
+void run_serial(graph& g) {
+  plan p{g};
+  run_serial(p);
+}
+
+void run_serial(plan& p) { run_nodes(p.order()); }
+
+void run_for(plan& p, std::vector<node*> targets) {
+  run_nodes(p.cone(std::move(targets)));
+}
+
+void run_parallel(plan& p, const partitioning& parts,
+                  const std::vector<int>& cpus) {
+  run_partitions(p, parts, [&](const auto& task) {
+    std::vector<std::thread> threads;
+    threads.reserve(parts.parts.size());
+    for (std::size_t k = 0; k < parts.parts.size(); ++k) {
+      if (parts.parts[k].empty()) continue;
+      threads.emplace_back([&task, k, cpu = cpu_for(cpus, k)] {
+        if (cpu >= 0) pin_this_thread(cpu);
+        task(k);
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  });
+}
+
+parallel_runner::parallel_runner(std::size_t workers, std::vector<int> cpus)
+    : pinned{!cpus.empty()} {
+  threads.reserve(workers);
+  for (std::size_t k = 0; k < workers; ++k) {
+    threads.emplace_back([this, k, cpu = cpu_for(cpus, k)] { work(k, cpu); });
+  }
+}
+
+parallel_runner::~parallel_runner() {
+  {
+    std::lock_guard lock{mutex};
+    stopping = true;
   }
+  wake.notify_all();
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+std::size_t parallel_runner::size() const { return threads.size(); }
 
-  // run in order
-  for (auto& n : sorted) {
-    (*n)();
+void parallel_runner::run(plan& p, const partitioning& parts) {
+  if (parts.parts.size() > threads.size()) {
+    throw std::runtime_error("More partitions than workers");
+  }
+  std::lock_guard one_run{run_mutex};
+  // port values move to their worker's NUMA node once per plan and partitioning
+  bool place = pinned && (&p != placed || parts.revision != placed_revision);
+  run_partitions(p, parts, [&](const auto& task) {
+    std::unique_lock lock{mutex};
+    job = [&task, &parts, place](std::size_t k) {
+      if (k >= parts.parts.size() || parts.parts[k].empty()) return;
+      if (place) {
+        for (auto* n : parts.parts[k]) {
+          n->relocate();
+        }
+      }
+      task(k);
+    };
+    running = threads.size();
+    ++generation;
+    wake.notify_all();
+    finished.wait(lock, [this] { return running == 0; });
+    job = nullptr;
+  });
+  placed = &p;
+  placed_revision = parts.revision;
+}
+
+void parallel_runner::work(std::size_t k, int cpu) {
+  if (cpu >= 0) pin_this_thread(cpu);
+  std::uint64_t seen = 0;
+  std::unique_lock lock{mutex};
+  for (;;) {
+    wake.wait(lock, [this, &seen] { return stopping || generation != seen; });
+    if (stopping) return;
+    seen = generation;
+    lock.unlock();
+    // run_partitions catches node errors, so job does not throw
+    job(k);
+    lock.lock();
+    if (--running == 0) finished.notify_all();
+  }
+}
+
+deadline_report run_prioritized(
+    plan& p, const std::map<node*, std::chrono::nanoseconds>& deadlines,
+    const std::map<node*, double>& cost) {
+  using clock = std::chrono::steady_clock;
+  const auto& order = p.order();
+  const auto& g = p.get_graph();
+  const auto& adj = g.adjacency();
+
+  // latest time each node can start without making a deadline late
+  std::map<node*, double> latest_start;
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    auto* n = *it;
+    auto latest = std::numeric_limits<double>::infinity();
+    if (auto d = deadlines.find(n); d != deadlines.end()) {
+      latest = std::chrono::duration<double>(d->second).count();
+    }
+    for (auto* s : g.successors(n)) {
+      latest = std::min(latest, latest_start.at(s));
+    }
+    auto c = cost.find(n);
+    latest_start[n] = latest - (c == cost.end() ? 0.0 : c->second);
+  }
+
+  // most urgent first, execution order breaks ties
+  using entry = std::pair<double, std::size_t>;
+  std::priority_queue<entry, std::vector<entry>, std::greater<>> ready;
+  std::map<node*, std::size_t> pending;
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    pending[order[i]] = adj.at(order[i]).size();
+    if (pending[order[i]] == 0) ready.emplace(latest_start.at(order[i]), i);
+  }
+  std::map<node*, std::size_t> index;
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    index[order[i]] = i;
+  }
+
+  deadline_report report;
+  auto start = clock::now();
+  while (!ready.empty()) {
+    auto* n = order[ready.top().second];
+    ready.pop();
+    impl::invoke(*n);
+
+    if (auto d = deadlines.find(n); d != deadlines.end()) {
+      auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          clock::now() - start);
+      report.latency[n] = latency;
+      if (latency > d->second) report.missed.push_back(n);
+    }
+    for (auto* s : g.successors(n)) {
+      if (--pending.at(s) == 0) ready.emplace(latest_start.at(s), index.at(s));
+    }
   }
+  return report;
 }
-}  // namespace dataflow
\ No newline at end of file
+}  // namespace dataflow
@@ -0,0 +1,199 @@
+#include "dataflow/snapshot.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DATAFLOW_HAVE_MMAP
+#endif
+
+namespace dataflow {
+namespace {
+constexpr char magic[8] = {'D', 'F', 'S', 'N', 'A', 'P', '0', '1'};
+
+// Native endianness, snapshots are meant for restarting on the same machine
+struct entry {
+  std::int64_t node_id;
+  std::uint64_t port;
+  std::uint64_t port_type;
+  std::uint64_t offset;
+  std::uint64_t size;
+};
+
+template <typename T>
+void append(std::string& out, const T& value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+std::size_t restore(builder& b, std::string_view file) {
+  std::uint64_t count = 0;
+  if (file.size() < sizeof(magic) + sizeof(count) ||
+      std::memcmp(file.data(), magic, sizeof(magic)) != 0) {
+    throw std::runtime_error("Not a dataflow snapshot");
+  }
+  std::memcpy(&count, file.data() + sizeof(magic), sizeof(count));
+  auto table = sizeof(magic) + sizeof(count);
+  if (count > (file.size() - table) / sizeof(entry)) {
+    throw std::runtime_error("Truncated dataflow snapshot");
+  }
+
+  auto ids = b.ids();
+  std::size_t restored = 0;
+  for (std::uint64_t i = 0; i < count; ++i) {
+    entry e{};
+    std::memcpy(&e, file.data() + table + i * sizeof(entry), sizeof(entry));
+    if (e.offset > file.size() || e.size > file.size() - e.offset) {
+      throw std::runtime_error("Truncated dataflow snapshot");
+    }
+    if (!std::binary_search(ids.begin(), ids.end(), e.node_id)) continue;
+    auto& n = b.get(static_cast<int>(e.node_id));
+    if (e.port >= n.output_size()) continue;
+    // inputs share the output buffers, so restoring in place reaches them too
+    auto& p = const_cast<port&>(std::as_const(n).output(e.port));
+    if (p.id() != e.port_type || !p.serializable()) continue;
+    p.load(file.substr(e.offset, e.size));
+    ++restored;
+  }
+  return restored;
+}
+
+// Writes next to the target and swaps it in, so a crash never leaves a
+// partial snapshot behind
+bool write_file(const std::string& path, const std::string& image) {
+  auto temporary = path + ".tmp";
+  {
+    std::ofstream out{temporary, std::ios::binary | std::ios::trunc};
+    out.write(image.data(), static_cast<std::streamsize>(image.size()));
+    if (!out) return false;
+  }
+#ifdef _WIN32
+  std::remove(path.c_str());
+#endif
+  return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+}  // namespace
+
+std::string capture_snapshot(const builder& b) {
+  std::vector<entry> entries;
+  std::string data;
+  for (int id : b.ids()) {
+    const auto& n = std::as_const(b.get(id));
+    for (std::size_t i = 0; i < n.output_size(); ++i) {
+      const auto& p = n.output(i);
+      if (!p.serializable()) continue;
+      auto offset = data.size();
+      p.save(data);
+      entries.push_back({id, i, p.id(), offset, data.size() - offset});
+    }
+  }
+
+  std::string image{magic, sizeof(magic)};
+  append(image, static_cast<std::uint64_t>(entries.size()));
+  auto data_start = image.size() + entries.size() * sizeof(entry);
+  for (auto& e : entries) {
+    e.offset += data_start;
+    append(image, e);
+  }
+  image += data;
+  return image;
+}
+
+void save_snapshot(const builder& b, const std::string& path) {
+  if (!write_file(path, capture_snapshot(b))) {
+    throw std::runtime_error("Could not write snapshot " + path);
+  }
+}
+
+std::size_t restore_snapshot(builder& b, const std::string& path) {
+#ifdef DATAFLOW_HAVE_MMAP
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("Could not open snapshot " + path);
+  struct stat info {};
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    throw std::runtime_error("Not a dataflow snapshot");
+  }
+  auto size = static_cast<std::size_t>(info.st_size);
+  void* ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    throw std::runtime_error("Could not map snapshot " + path);
+  }
+  try {
+    auto restored = restore(b, {static_cast<const char*>(ptr), size});
+    munmap(ptr, size);
+    return restored;
+  } catch (...) {
+    munmap(ptr, size);
+    throw;
+  }
+#else
+  std::ifstream in{path, std::ios::binary};
+  if (!in) throw std::runtime_error("Could not open snapshot " + path);
+  std::string file{std::istreambuf_iterator<char>(in), {}};
+  return restore(b, file);
+#endif
+}
+
+snapshot_writer::snapshot_writer(std::string path)
+    : path{std::move(path)}, worker{[this] { write_loop(); }} {}
+
+snapshot_writer::~snapshot_writer() {
+  {
+    std::lock_guard lock{mutex};
+    stopping = true;
+  }
+  changed.notify_all();
+  worker.join();
+}
+
+void snapshot_writer::capture(const builder& b) {
+  auto image = capture_snapshot(b);
+  {
+    std::lock_guard lock{mutex};
+    pending = std::move(image);
+    has_pending = true;
+  }
+  changed.notify_all();
+}
+
+void snapshot_writer::flush() {
+  std::unique_lock lock{mutex};
+  changed.wait(lock, [this] { return !has_pending && !writing; });
+  if (write_failed) {
+    throw std::runtime_error("Could not write snapshot " + path);
+  }
+}
+
+void snapshot_writer::write_loop() {
+  std::unique_lock lock{mutex};
+  for (;;) {
+    changed.wait(lock, [this] { return has_pending || stopping; });
+    if (!has_pending) return;
+    auto image = std::move(pending);
+    has_pending = false;
+    writing = true;
+    lock.unlock();
+
+    // reported by flush, the next capture retries
+    bool written = write_file(path, image);
+
+    lock.lock();
+    write_failed = !written;
+    writing = false;
+    changed.notify_all();
+  }
+}
+}  // namespace dataflow
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "dataflow/dataflow.hpp"
+
+namespace {
+class constant final : public dataflow::outputs<int> {
+ public:
+  explicit constant(int value) { outputs::get<0>() = value; }
+  void set(int value) { outputs::get<0>() = value; }
+};
+
+class doubler final : public dataflow::inputs<int>,
+                      public dataflow::outputs<int> {
+ public:
+  void operator()() override {
+    outputs::get<0>() = 2 * inputs::get<0>();
+    last = outputs::get<0>();
+  }
+  int last = 0;
+};
+
+const char* config = R"({
+  "nodes": [
+    {"id": 0, "type": "builder_test_constant", "data": {"value": 1}},
+    {"id": 1, "type": "builder_test_doubler", "data": {}}
+  ],
+  "links": [
+    {"from": {"id": 0, "port": 0}, "to": {"id": 1, "port": 0}}
+  ]
+})";
+
+void register_types() {
+  dataflow::registry::register_type(
+      "builder_test_constant", [](const nlohmann::json& data) {
+        return std::make_unique<constant>(data["value"].get<int>());
+      });
+  dataflow::registry::register_type(
+      "builder_test_doubler",
+      [](const nlohmann::json&) { return std::make_unique<doubler>(); });
+}
+}  // namespace
+
+TEST(Dataflow, instance_pool_runs_clones_independently) {
+  register_types();
+  const dataflow::builder prototype{config};
+  dataflow::instance_pool pool{prototype, 4};
+  EXPECT_EQ(pool.size(), 4U);
+
+  std::vector<int> results(8);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < 8; ++i) {
+    workers.emplace_back([&pool, &results, i] {
+      auto instance = pool.acquire();
+      dynamic_cast<constant&>(instance.nodes().get(0)).set(i);
+      dataflow::run_serial(instance.get_plan());
+      results[i] = dynamic_cast<doubler&>(instance.nodes().get(1)).last;
+    });
+  }
+  for (auto& w : workers) w.join();
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(results[i], 2 * i);
+  }
+}
+
+TEST(Dataflow, builder_reconfigure_keeps_links) {
+  register_types();
+  dataflow::builder b{config};
+  dataflow::graph g{b.adjacency()};
+  dataflow::plan p{g};
+
+  b.reconfigure(0, {{"value", 5}}, g);
+  dataflow::run_serial(p);
+  EXPECT_EQ(dynamic_cast<doubler&>(b.get(1)).last, 10);
+
+  b.add(2, "builder_test_doubler", {}, g);
+  b.connect(1, 0, 2, 0, g);
+  dataflow::run_serial(p);
+  EXPECT_EQ(dynamic_cast<doubler&>(b.get(2)).last, 20);
+
+  // clones pick up the edited link table
+  auto copy = b.clone();
+  dataflow::graph copy_graph{copy->adjacency()};
+  dataflow::run_serial(copy_graph);
+  EXPECT_EQ(dynamic_cast<doubler&>(copy->get(2)).last, 20);
+
+  // connecting a single input again replaces its link
+  b.add(3, "builder_test_constant", {{"value", 7}}, g);
+  b.connect(3, 0, 2, 0, g);
+  EXPECT_EQ(b.adjacency().at(&b.get(2)),
+            std::set<dataflow::node*>{&b.get(3)});
+  EXPECT_EQ(b.adjacency(), g.adjacency());
+
+  b.remove(1, g);
+  EXPECT_EQ(g.adjacency().size(), 3U);
+  EXPECT_EQ(b.adjacency(), g.adjacency());
+  dataflow::run_serial(p);
+  EXPECT_EQ(dynamic_cast<doubler&>(b.get(2)).last, 14);
+}
+
+TEST(Dataflow, snapshot_restores_output_values) {
+  register_types();
+  auto path = ::testing::TempDir() + "dataflow_snapshot.bin";
+  {
+    dataflow::builder b{config};
+    dataflow::graph g{b.adjacency()};
+    b.reconfigure(0, {{"value", 21}}, g);
+    dataflow::run_serial(g);
+
+    dataflow::snapshot_writer writer{path};
+    writer.capture(b);
+    writer.flush();
+
+    dataflow::snapshot_writer unwritable{path + ".missing/snapshot"};
+    unwritable.capture(b);
+    EXPECT_THROW(unwritable.flush(), std::runtime_error);
+  }
+
+  dataflow::builder restarted{config};
+  EXPECT_EQ(dataflow::restore_snapshot(restarted, path), 2U);
+  using int_port = dataflow::impl::single_port<int>;
+  const auto& output = std::as_const(restarted.get(1)).output(0);
+  EXPECT_EQ(dynamic_cast<const int_port&>(output).data(), 42);
+  // the downstream input shares the restored buffer
+  const auto& input = std::as_const(restarted.get(1)).input(0);
+  EXPECT_EQ(dynamic_cast<const int_port&>(input).data(), 21);
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "dataflow/dataflow.hpp"
+
+namespace {
+class relay : public dataflow::inputs<int>, public dataflow::outputs<int> {
+ public:
+  void operator()() override { outputs::get<0>() = inputs::get<0>() + 1; }
+};
+
+bool before(const std::vector<dataflow::node*>& order, dataflow::node* a,
+            dataflow::node* b) {
+  return std::find(order.begin(), order.end(), a) <
+         std::find(order.begin(), order.end(), b);
+}
+}  // namespace
+
+TEST(Dataflow, graph_edits_keep_the_order_valid) {
+  relay a;
+  relay b;
+  relay c;
+  dataflow::graph g{&c, &b, &a};
+
+  g.connect(b, 0, c, 0);
+  g.connect(a, 0, b, 0);
+  EXPECT_TRUE(before(g.order(), &a, &b));
+  EXPECT_TRUE(before(g.order(), &b, &c));
+  EXPECT_EQ(g.adjacency().at(&c), std::set<dataflow::node*>{&b});
+
+  EXPECT_THROW(g.connect(c, 0, a, 0), std::runtime_error);
+  EXPECT_FALSE(a.input(0).connected_to(std::as_const(c).output(0)));
+  EXPECT_TRUE(g.successors(&c).empty());
+
+  // a rejected connection keeps the previous source of the input
+  relay s;
+  g.insert(&s);
+  g.connect(s, 0, a, 0);
+  EXPECT_THROW(g.connect(b, 0, a, 0), std::runtime_error);
+  EXPECT_TRUE(a.input(0).connected_to(std::as_const(s).output(0)));
+  EXPECT_EQ(g.adjacency().at(&a), std::set<dataflow::node*>{&s});
+  g.disconnect(s, 0, a, 0);
+  g.erase(&s);
+
+  relay d;
+  d.inputs::connect<0>() = c.outputs::connect<0>();
+  g.insert(&d);
+  EXPECT_TRUE(before(g.order(), &c, &d));
+
+  g.erase(&c);
+  EXPECT_EQ(g.order().size(), 3U);
+  EXPECT_TRUE(g.adjacency().at(&d).empty());
+  EXPECT_FALSE(d.input(0).connected_to(std::as_const(c).output(0)));
+
+  g.disconnect(a, 0, b, 0);
+  EXPECT_TRUE(g.adjacency().at(&b).empty());
+}
+
+TEST(Dataflow, graph_tracks_changed_nodes) {
+  relay a;
+  relay b;
+  dataflow::graph g{&a};
+  auto r = g.revision();
+
+  b.input(0) = std::as_const(a).output(0);
+  g.insert(&b, {&a});
+  EXPECT_EQ(g.adjacency().at(&b), std::set<dataflow::node*>{&a});
+  EXPECT_TRUE(before(g.order(), &a, &b));
+  EXPECT_EQ(g.changed_since(r), std::vector<dataflow::node*>{&b});
+
+  r = g.revision();
+  g.erase(&a);
+  EXPECT_EQ(g.changed_since(r), std::vector<dataflow::node*>{&b});
+  EXPECT_EQ(g.changed_since(g.revision()), std::vector<dataflow::node*>{});
+}
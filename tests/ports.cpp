@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "dataflow/dataflow.hpp"
+
+namespace {
+class counter : public dataflow::outputs<dataflow::buffered<int>> {
+ public:
+  void operator()() override { ++outputs::get<0>(); }
+};
+
+class sink : public dataflow::inputs<int> {
+ public:
+  void operator()() override { last = inputs::get<0>(); }
+  int last = 0;
+};
+}  // namespace
+
+TEST(Dataflow, buffered_port_publishes_each_run) {
+  counter source;
+  sink consumer;
+  consumer.inputs::connect<0>() = source.outputs::connect<0>();
+  dataflow::graph g{&source, &consumer};
+
+  EXPECT_FALSE(source.published<0>());
+
+  dataflow::run_serial(g);
+  auto first = source.published<0>();
+  ASSERT_TRUE(first);
+  EXPECT_EQ(*first, 1);
+  EXPECT_EQ(first.epoch(), 1U);
+  EXPECT_EQ(consumer.last, 1);
+
+  // The pinned result of the first run stays stable
+  dataflow::run_serial(g);
+  EXPECT_EQ(*first, 1);
+  auto second = source.published<0>();
+  EXPECT_EQ(*second, 2);
+  EXPECT_EQ(second.epoch(), 2U);
+
+  // Both buffers are pinned, so publishing is skipped rather than blocking
+  dataflow::run_serial(g);
+  EXPECT_EQ(consumer.last, 3);
+  EXPECT_EQ(source.published<0>().epoch(), 2U);
+}
+
+TEST(Dataflow, relocated_ports_keep_value_and_readers) {
+  dataflow::impl::single_port<std::vector<int>> output{true};
+  dataflow::impl::single_port<std::vector<int>> input;
+  input = output;
+  output.data().assign(1000, 7);
+
+  output.relocate();
+  EXPECT_TRUE(input.connected_to(output));
+  EXPECT_EQ(input.data(), std::vector<int>(1000, 7));
+}
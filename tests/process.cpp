@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <string>
+
+#include "dataflow/dataflow.hpp"
+#include "dataflow/process.hpp"
+
+template <>
+struct dataflow::serializer<std::string> {
+  static constexpr bool enabled = true;
+  static void save(const std::string& value, std::string& out) {
+    out += value;
+  }
+  static void load(std::string& value, std::string_view in) { value = in; }
+};
+
+namespace {
+class counter final : public dataflow::outputs<int> {
+ public:
+  void operator()() override { ++outputs::get<0>(); }
+};
+
+class doubler final : public dataflow::inputs<int>,
+                      public dataflow::outputs<int> {
+ public:
+  void operator()() override { outputs::get<0>() = 2 * inputs::get<0>(); }
+};
+
+class describe final : public dataflow::inputs<int>,
+                       public dataflow::outputs<std::string> {
+ public:
+  void operator()() override {
+    outputs::get<0>() = "value " + std::to_string(inputs::get<0>());
+  }
+};
+
+class collect final : public dataflow::inputs<int, std::string> {
+ public:
+  void operator()() override {
+    number = inputs::get<0>();
+    text = inputs::get<1>();
+  }
+  int number = 0;
+  std::string text;
+};
+
+class crash final : public dataflow::inputs<int> {
+ public:
+  void operator()() override { std::_Exit(3); }
+};
+
+void register_types() {
+  dataflow::registry::register_type("process_test_counter", [](auto&) {
+    return std::make_unique<counter>();
+  });
+  dataflow::registry::register_type("process_test_doubler", [](auto&) {
+    return std::make_unique<doubler>();
+  });
+  dataflow::registry::register_type("process_test_describe", [](auto&) {
+    return std::make_unique<describe>();
+  });
+  dataflow::registry::register_type("process_test_collect", [](auto&) {
+    return std::make_unique<collect>();
+  });
+  dataflow::registry::register_type("process_test_crash", [](auto&) {
+    return std::make_unique<crash>();
+  });
+}
+
+const char* config = R"({
+  "nodes": [
+    {"id": 0, "type": "process_test_counter", "process": 1, "data": {}},
+    {"id": 1, "type": "process_test_doubler", "process": 2, "data": {}},
+    {"id": 2, "type": "process_test_describe", "process": 1, "data": {}},
+    {"id": 3, "type": "process_test_collect", "data": {}}
+  ],
+  "links": [
+    {"from": {"id": 0, "port": 0}, "to": {"id": 1, "port": 0}},
+    {"from": {"id": 1, "port": 0}, "to": {"id": 2, "port": 0}},
+    {"from": {"id": 1, "port": 0}, "to": {"id": 3, "port": 0}},
+    {"from": {"id": 2, "port": 0}, "to": {"id": 3, "port": 1}}
+  ]
+})";
+}  // namespace
+
+TEST(Dataflow, process_group_moves_values_between_processes) {
+  register_types();
+  dataflow::process_group group{config};
+  EXPECT_EQ(group.size(), 3U);
+
+  auto& sink = dynamic_cast<collect&>(group.local().get(3));
+  group.run();
+  EXPECT_EQ(sink.number, 2);
+  EXPECT_EQ(sink.text, "value 2");
+  group.run();
+  EXPECT_EQ(sink.number, 4);
+  EXPECT_EQ(sink.text, "value 4");
+}
+
+TEST(Dataflow, process_group_reports_crashed_workers) {
+  register_types();
+  dataflow::process_group group{R"({
+    "nodes": [
+      {"id": 0, "type": "process_test_counter", "data": {}},
+      {"id": 1, "type": "process_test_crash", "process": 1, "data": {}}
+    ],
+    "links": [
+      {"from": {"id": 0, "port": 0}, "to": {"id": 1, "port": 0}}
+    ]
+  })"};
+  EXPECT_THROW(group.run(), std::runtime_error);
+  EXPECT_THROW(group.run(), std::runtime_error);
+}
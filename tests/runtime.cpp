@@ -0,0 +1,375 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dataflow/dataflow.hpp"
+
+namespace {
+class source : public dataflow::outputs<int> {
+ public:
+  void operator()() override {
+    ++runs;
+    outputs::get<0>() = runs;
+  }
+  int runs = 0;
+};
+
+class optional_relay : public dataflow::inputs<dataflow::optional<int>>,
+                       public dataflow::outputs<int> {
+ public:
+  void operator()() override {
+    outputs::get<0>() = inputs::has<0>() ? inputs::get<0>() : -1;
+  }
+};
+
+class sum : public dataflow::inputs<dataflow::many<int>>,
+            public dataflow::outputs<int> {
+ public:
+  void operator()() override {
+    outputs::get<0>() = 0;
+    for (auto v : inputs::get<0>()) outputs::get<0>() += v;
+  }
+};
+
+class relay : public dataflow::inputs<int>, public dataflow::outputs<int> {
+ public:
+  void operator()() override {
+    ++runs;
+    outputs::get<0>() = inputs::get<0>();
+  }
+  int runs = 0;
+};
+
+class gate : public dataflow::outputs<int> {
+ public:
+  void operator()() override {
+    while (!open) std::this_thread::yield();
+  }
+  std::atomic<bool> open = false;
+};
+
+// Records the order in which nodes run and how many run at once
+class tagger : public dataflow::outputs<int> {
+ public:
+  tagger(char tag, std::vector<char>& log, std::mutex& mutex,
+         std::atomic<int>& running, int& most)
+      : tag{tag}, log{&log}, mutex{&mutex}, running{&running}, most{&most} {}
+  void operator()() override {
+    auto now = ++*running;
+    {
+      std::lock_guard lock{*mutex};
+      log->push_back(tag);
+      *most = std::max(*most, now);
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    --*running;
+  }
+
+ private:
+  char tag;
+  std::vector<char>* log;
+  std::mutex* mutex;
+  std::atomic<int>* running;
+  int* most;
+};
+
+class grower : public dataflow::outputs<std::vector<int>> {
+ public:
+  void operator()() override { outputs::get<0>().resize(1000); }
+};
+}  // namespace
+
+TEST(Dataflow, run_for_executes_only_the_target_cone) {
+  source src;
+  relay main_branch;
+  relay debug_branch;
+  main_branch.inputs::connect<0>() = src.outputs::connect<0>();
+  debug_branch.inputs::connect<0>() = src.outputs::connect<0>();
+  dataflow::graph g{&src, &main_branch, &debug_branch};
+  dataflow::plan p{g};
+
+  const auto& cone = p.cone({&main_branch});
+  EXPECT_EQ(cone, (std::vector<dataflow::node*>{&src, &main_branch}));
+  EXPECT_EQ(&cone, &p.cone({&main_branch, &main_branch}));
+
+  dataflow::run_for(p, {&main_branch});
+  dataflow::run_for(p, {&main_branch});
+  EXPECT_EQ(src.runs, 2);
+  EXPECT_EQ(main_branch.runs, 2);
+  EXPECT_EQ(debug_branch.runs, 0);
+
+  dataflow::run_serial(p);
+  EXPECT_EQ(debug_branch.runs, 1);
+}
+
+TEST(Dataflow, run_parallel_matches_serial_results) {
+  source src;
+  std::vector<relay> chain(6);
+  chain[0].inputs::connect<0>() = src.outputs::connect<0>();
+  for (std::size_t i = 1; i < chain.size(); ++i) {
+    chain[i].inputs::connect<0>() = chain[i - 1].outputs::connect<0>();
+  }
+  relay side;
+  side.inputs::connect<0>() = chain[2].outputs::connect<0>();
+
+  std::vector<dataflow::node*> nodes{&src, &side};
+  for (auto& n : chain) nodes.push_back(&n);
+  dataflow::graph g{nodes};
+  dataflow::plan p{g};
+
+  auto parts = dataflow::partition(p, 3);
+  std::size_t total = 0;
+  for (auto& part : parts.parts) total += part.size();
+  EXPECT_EQ(total, nodes.size());
+  EXPECT_LT(parts.cut_edges, nodes.size() - 1);
+
+  dataflow::run_parallel(p, parts, dataflow::numa_ordered_cpus());
+  EXPECT_EQ(src.runs, 1);
+  EXPECT_EQ(side.runs, 1);
+  for (auto& n : chain) EXPECT_EQ(n.runs, 1);
+
+  // persistent workers give the same results run after run
+  dataflow::parallel_runner runner{parts.parts.size(),
+                                   dataflow::numa_ordered_cpus()};
+  for (int i = 0; i < 3; ++i) runner.run(p, parts);
+  EXPECT_EQ(src.runs, 4);
+  for (auto& n : chain) EXPECT_EQ(n.runs, 4);
+  EXPECT_THROW(dataflow::parallel_runner{1}.run(p, parts), std::runtime_error);
+}
+
+TEST(Dataflow, plan_reports_every_problem) {
+  relay first;
+  relay second;
+  optional_relay optional;
+  relay outside;
+  second.inputs::connect<0>() = outside.outputs::connect<0>();
+  dataflow::graph g{&first, &second, &optional};
+
+  try {
+    dataflow::plan p{g};
+    FAIL() << "Expected a validation error";
+  } catch (const dataflow::validation_error& e) {
+    EXPECT_EQ(e.problems().size(), 2U);
+  }
+
+  g.connect(optional, 0, first, 0);
+  g.connect(first, 0, second, 0);
+  dataflow::plan p{g};
+  dataflow::run_serial(p);
+  EXPECT_EQ(first.runs, 1);
+
+  // every source of a many input has to be part of the graph
+  sum total;
+  source extra;
+  total.inputs::connect<0>() = first.outputs::connect<0>();
+  total.inputs::connect<0>() = extra.outputs::connect<0>();
+  g.insert(&total);
+  EXPECT_EQ(dataflow::validate(g).size(), 1U);
+  g.insert(&extra);
+  EXPECT_TRUE(dataflow::validate(g).empty());
+
+  // the plan checks the nodes touched by edits again
+  EXPECT_EQ(p.order().size(), 5U);
+  g.disconnect(first, 0, second, 0);
+  EXPECT_THROW((void)p.order(), dataflow::validation_error);
+}
+
+TEST(Dataflow, run_prioritized_runs_urgent_branches_first) {
+  using namespace std::chrono_literals;
+  source src;
+  std::vector<relay> logging(3);
+  relay control;
+  logging[0].inputs::connect<0>() = src.outputs::connect<0>();
+  logging[1].inputs::connect<0>() = logging[0].outputs::connect<0>();
+  logging[2].inputs::connect<0>() = logging[1].outputs::connect<0>();
+  control.inputs::connect<0>() = src.outputs::connect<0>();
+  dataflow::graph g{&src, &logging[0], &logging[1], &logging[2], &control};
+  dataflow::plan p{g};
+
+  auto report = dataflow::run_prioritized(p, {{&control, 10s}});
+  EXPECT_EQ(control.runs, 1);
+  EXPECT_EQ(logging[2].runs, 1);
+  EXPECT_EQ(report.latency.size(), 1U);
+  EXPECT_TRUE(report.missed.empty());
+
+  // the control output goes first even though logging comes first in order
+  report = dataflow::run_prioritized(p, {{&control, 1s}, {&logging[2], 10s}});
+  EXPECT_LT(report.latency.at(&control), report.latency.at(&logging[2]));
+
+  report = dataflow::run_prioritized(p, {{&control, -1s}});
+  EXPECT_EQ(report.missed, std::vector<dataflow::node*>{&control});
+}
+
+TEST(Dataflow, executor_shares_workers_between_graphs) {
+  std::vector<source> sources(2);
+  std::vector<relay> relays(2);
+  std::vector<dataflow::graph> graphs;
+  for (std::size_t i = 0; i < 2; ++i) {
+    relays[i].inputs::connect<0>() = sources[i].outputs::connect<0>();
+    graphs.push_back(dataflow::graph{&sources[i], &relays[i]});
+  }
+  dataflow::plan first{graphs[0]};
+  dataflow::plan second{graphs[1]};
+
+  {
+    dataflow::executor ex{2};
+    dataflow::run_options heavy;
+    heavy.weight = 2.0;
+    dataflow::run_options narrow;
+    narrow.max_parallel = 1;
+    std::vector<dataflow::executor::run_handle> runs;
+    for (int i = 0; i < 5; ++i) {
+      runs.push_back(ex.submit(first, heavy));
+      runs.push_back(ex.submit(second, narrow));
+    }
+    for (auto& r : runs) r.completion().get();
+  }
+  EXPECT_EQ(relays[0].runs, 5);
+  EXPECT_EQ(relays[1].runs, 5);
+
+  // with the only worker busy the cancelled run never starts
+  gate blocker;
+  dataflow::graph blocked{&blocker};
+  dataflow::plan blocked_plan{blocked};
+  dataflow::executor ex{1};
+  auto busy = ex.submit(blocked_plan);
+  auto cancelled = ex.submit(first);
+  cancelled.cancel();
+  blocker.open = true;
+  busy.wait();
+  EXPECT_THROW(cancelled.completion().get(), std::runtime_error);
+  EXPECT_EQ(relays[0].runs, 5);
+}
+
+TEST(Dataflow, executor_dispatches_by_weight) {
+  std::vector<char> log;
+  std::mutex mutex;
+  std::atomic<int> running = 0;
+  int most = 0;
+  std::vector<std::unique_ptr<tagger>> heavy_nodes;
+  std::vector<std::unique_ptr<tagger>> light_nodes;
+  std::vector<dataflow::node*> heavy_ptrs;
+  std::vector<dataflow::node*> light_ptrs;
+  for (int i = 0; i < 6; ++i) {
+    heavy_nodes.push_back(
+        std::make_unique<tagger>('h', log, mutex, running, most));
+    light_nodes.push_back(
+        std::make_unique<tagger>('l', log, mutex, running, most));
+    heavy_ptrs.push_back(heavy_nodes.back().get());
+    light_ptrs.push_back(light_nodes.back().get());
+  }
+  dataflow::graph heavy_graph{heavy_ptrs};
+  dataflow::graph light_graph{light_ptrs};
+  dataflow::plan heavy{heavy_graph};
+  dataflow::plan light{light_graph};
+
+  {
+    // one worker, held until both runs are queued
+    dataflow::executor ex{1};
+    gate blocker;
+    dataflow::graph blocked{&blocker};
+    dataflow::plan blocked_plan{blocked};
+    auto busy = ex.submit(blocked_plan);
+    dataflow::run_options twice;
+    twice.weight = 2.0;
+    auto h = ex.submit(heavy, twice);
+    auto l = ex.submit(light);
+    blocker.open = true;
+    h.completion().get();
+    l.completion().get();
+  }
+  // the light run keeps getting a third of the dispatches while both have
+  // work left
+  ASSERT_EQ(log.size(), 12U);
+  EXPECT_EQ(std::string(log.begin(), log.begin() + 9), "hlhhlhhlh");
+
+  {
+    dataflow::executor ex{2};
+    dataflow::run_options narrow;
+    narrow.max_parallel = 1;
+    most = 0;
+    ex.submit(light, narrow).completion().get();
+    EXPECT_EQ(most, 1);
+  }
+
+  {
+    // edits are safe once the runs of a plan are drained
+    dataflow::executor ex{2};
+    auto run = ex.submit(light);
+    ex.drain(light);
+    EXPECT_EQ(run.completion().wait_for(std::chrono::seconds(0)),
+              std::future_status::ready);
+    tagger extra{'x', log, mutex, running, most};
+    light_graph.insert(&extra, {});
+    log.clear();
+    ex.submit(light).completion().get();
+    EXPECT_EQ(log.size(), 7U);
+    ex.drain(light);
+    light_graph.erase(&extra);
+  }
+
+  // handles may outlive their executor
+  std::optional<dataflow::executor::run_handle> late;
+  {
+    dataflow::executor ex{1};
+    late = ex.submit(light);
+  }
+  late->cancel();
+  late->wait();
+}
+
+TEST(Dataflow, allocation_profile_attributes_heap_use_to_nodes) {
+  source src;
+  grower big;
+  src.set_label("src");
+  big.set_label("big");
+  dataflow::graph g{&src, &big};
+  dataflow::plan p{g};
+
+  dataflow::allocation_profile profile;
+  dataflow::run_serial(p, profile);
+  dataflow::run_serial(p, profile);
+  EXPECT_EQ(profile.at(&big).invocations, 2U);
+  EXPECT_GE(profile.at(&big).port_bytes, 1000 * sizeof(int));
+  EXPECT_EQ(profile.at(&src).port_bytes, sizeof(int));
+  if (dataflow::allocation_tracking_enabled()) {
+    // only the first run has to grow the vector
+    EXPECT_EQ(profile.at(&big).allocations, 1U);
+    EXPECT_GE(profile.at(&big).bytes, 1000 * sizeof(int));
+    EXPECT_EQ(profile.at(&src).allocations, 0U);
+  }
+
+  std::ostringstream out;
+  dataflow::report_allocations(profile, out);
+  EXPECT_LT(out.str().find("big"), out.str().find("src"));
+
+  // the other runtimes are recorded through the same hook
+  {
+    dataflow::allocation_recorder recorder{profile};
+    EXPECT_THROW(dataflow::allocation_recorder{profile}, std::runtime_error);
+    dataflow::run_parallel(p, dataflow::partition(p, 2));
+    dataflow::run_prioritized(p, {});
+    dataflow::executor ex{2};
+    ex.submit(p).wait();
+  }
+  EXPECT_EQ(profile.at(&src).invocations, 5U);
+  EXPECT_EQ(profile.at(&big).invocations, 5U);
+  if (dataflow::allocation_tracking_enabled()) {
+    EXPECT_EQ(profile.at(&big).allocations, 1U);
+  }
+
+  // nothing is recorded once the recorder is gone
+  dataflow::run_serial(p);
+  EXPECT_EQ(profile.at(&big).invocations, 5U);
+}
@@ -11,4 +11,32 @@ TEST(Dataflow, runtime_type_safety) {
   FloatIn in;
 
   EXPECT_ANY_THROW(in.input(0) = std::as_const(out).output(0));
-}
\ No newline at end of file
+}
+TEST(Dataflow, port_type_ids) {
+  static_assert(dataflow::type_id_v<int> == dataflow::type_id_of<int>());
+  static_assert(dataflow::type_id_v<int> != dataflow::type_id_v<float>);
+
+  IntOut out;
+  FloatIn in;
+  EXPECT_NE(std::as_const(out).output(0).id(), in.input(0).id());
+  EXPECT_EQ(std::as_const(out).output(0).id(),
+            dataflow::type_id_v<dataflow::impl::single_port<int>>);
+}
+
+namespace {
+// A port written against the original interface
+struct legacy_port : public dataflow::port {
+  [[nodiscard]] const std::type_info& type() const override {
+    return typeid(legacy_port);
+  }
+  void try_connect(const port&) override {}
+  bool connected_to(const port&) const override { return false; }
+};
+}  // namespace
+
+TEST(Dataflow, ports_need_only_the_original_overrides) {
+  legacy_port p;
+  EXPECT_EQ(p.id(), 0U);
+  EXPECT_THROW((void)p.make_source(), std::runtime_error);
+  EXPECT_THROW(p.disconnect(p), std::runtime_error);
+}